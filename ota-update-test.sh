@@ -0,0 +1,33 @@
+#!/bin/bash -e
+
+host=$1
+binfile=$2
+
+if [ -z "${host}" -o -z "${binfile}" ]
+then
+	echo "Syntax: $0 <host> <binfile>"
+	exit 1
+fi
+
+# uploads that must be rejected, none of them may activate the image
+md5=$(openssl dgst -md5 -r "${binfile}" | cut -d ' ' -f 1)
+sha256=$(openssl dgst -sha256 -r "${binfile}" | cut -d ' ' -f 1)
+wrong_md5=00000000000000000000000000000000
+wrong_sha256=0000000000000000000000000000000000000000000000000000000000000000
+
+expect_status() {
+	name=$1
+	expected=$2
+	query=$3
+	status=$(curl -s -o /dev/null -w "%{http_code}" -F "firmware=@${binfile}" "http://${host}/api/update?${query}")
+	if [ "${status}" != "${expected}" ]
+	then
+		echo "${name}: expected HTTP ${expected}, got ${status}"
+		exit 1
+	fi
+	echo "${name}: HTTP ${status}"
+}
+
+expect_status "wrong md5" 400 "md5=${wrong_md5}&sha256=${sha256}"
+expect_status "wrong sha256" 400 "md5=${md5}&sha256=${wrong_sha256}"
+expect_status "malformed sha256" 400 "sha256=${sha256:1}"
@@ -9,4 +9,9 @@ then
 	exit 1
 fi
 
-espota.py -d -i "${host}" -f "${binfile}"
+# the image is verified on the device before it is activated
+md5=$(openssl dgst -md5 -r "${binfile}" | cut -d ' ' -f 1)
+sha256=$(openssl dgst -sha256 -r "${binfile}" | cut -d ' ' -f 1)
+
+curl --fail-with-body -F "firmware=@${binfile}" "http://${host}/api/update?md5=${md5}&sha256=${sha256}"
+echo
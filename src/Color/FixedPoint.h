@@ -0,0 +1,52 @@
+#ifndef COLOR_FIXEDPOINT_H_
+#define COLOR_FIXEDPOINT_H_
+
+#include <cstdint>
+
+namespace Color {
+
+// integer versions of the LED transforms, so the render path doesn't need soft-float math
+// levels are Q16, 0 to 65536 for 0.0 to 1.0; results are truncated, i.e. at most 1 LSB below the exact value
+
+// x -> x * x
+constexpr uint32_t squareQ16(uint32_t x) {
+    return x >= 65536 ? 65536 : (x * x) >> 16;
+}
+
+// x -> sqrt(x), bit by bit on the Q32 square
+constexpr uint32_t squareRootQ16(uint32_t x) {
+    if (x >= 65536) {
+        return 65536;
+    }
+    uint32_t remainder = x << 16;
+    uint32_t root = 0;
+    for (uint32_t bit = 1UL << 30; bit; bit >>= 2) {
+        if (remainder >= root + bit) {
+            remainder -= root + bit;
+            root = (root >> 1) + bit;
+        } else {
+            root >>= 1;
+        }
+    }
+    return root;
+}
+
+// x -> 1 - (1 - x) * (1 - x)
+constexpr uint32_t inverseSquareQ16(uint32_t x) {
+    // the square is rounded up, so the result is truncated like the others
+    return x >= 65536 ? 65536 : x == 0 ? 0 : 65536 - ((65536 - x) * (65536 - x) + 65535) / 65536;
+}
+
+// value * fraction, with the fraction in Q8 (0 to 255 for 0.0 to 255/256)
+constexpr uint8_t scale8(uint8_t value, uint8_t fraction) {
+    return (value * fraction) >> 8;
+}
+
+static_assert(squareQ16(32768) == 16384, "0.5^2 = 0.25");
+static_assert(squareRootQ16(16384) == 32768, "sqrt(0.25) = 0.5");
+static_assert(squareRootQ16(2) == 362, "sqrt(2/65536) * 65536 = 362.04");
+static_assert(inverseSquareQ16(32768) == 49152, "1 - 0.5^2 = 0.75");
+
+} // namespace Color
+
+#endif /* COLOR_FIXEDPOINT_H_ */
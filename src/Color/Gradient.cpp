@@ -30,11 +30,30 @@ RGB Gradient::get(uint16_t pos) const {
 
     // (--a)->first < pos < b->first -> interpolate
     --a;
-    uint16_t pos1 = a->first;
-    RGB rgb1 = a->second;
-    uint16_t pos2 = b->first;
-    RGB rgb2 = b->second;
+    return _interpolate(pos, a->first, a->second, b->first, b->second);
+}
+
+void Gradient::bake(RGB *table, uint16_t length) const {
+    // must have called "set" before
+    assert(!_rgb.empty());
+
+    auto a = _rgb.begin(); // largest entry that is <= pos (or the smallest entry, if there is none)
+    auto b = _rgb.begin(); // smallest entry that is > pos
+    for (uint16_t pos = 0; pos < length; pos++) {
+        while (b != _rgb.end() && b->first <= pos) {
+            a = b++;
+        }
+        if (a->first >= pos || b == _rgb.end()) {
+            // exact match, or pos outside of the entries -> repeat the nearest entry
+            table[pos] = a->second;
+        } else {
+            // a->first < pos < b->first -> interpolate
+            table[pos] = _interpolate(pos, a->first, a->second, b->first, b->second);
+        }
+    }
+}
 
+RGB Gradient::_interpolate(uint16_t pos, uint16_t pos1, const RGB &rgb1, uint16_t pos2, const RGB &rgb2) {
     RGB result;
     result.red = rgb1.red + (pos - pos1) * (rgb2.red - rgb1.red) / (pos2 - pos1);
     result.green = rgb1.green + (pos - pos1) * (rgb2.green - rgb1.green) / (pos2 - pos1);
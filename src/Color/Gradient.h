@@ -15,8 +15,13 @@ class Gradient : public Pattern {
 
     RGB get(uint16_t pos) const override;
 
+    // single sweep over the entries instead of a lookup per position
+    void bake(RGB *table, uint16_t length) const override;
+
   private:
     std::map<uint16_t, RGB> _rgb;
+
+    static RGB _interpolate(uint16_t pos, uint16_t pos1, const RGB &rgb1, uint16_t pos2, const RGB &rgb2);
 };
 
 } /* namespace Color */
@@ -0,0 +1,13 @@
+#include "Pattern.h"
+
+#include "RGB.h"
+
+namespace Color {
+
+void Pattern::bake(RGB *table, uint16_t length) const {
+    for (uint16_t pos = 0; pos < length; pos++) {
+        table[pos] = get(pos);
+    }
+}
+
+} /* namespace Color */
@@ -13,6 +13,10 @@ class Pattern {
     }
 
     virtual RGB get(uint16_t pos) const = 0;
+
+    // evaluate the pattern for positions 0 to length-1 into a flat table
+    // the default implementation calls get() for every position
+    virtual void bake(RGB *table, uint16_t length) const;
 };
 
 } /* namespace Color */
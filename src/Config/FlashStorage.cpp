@@ -0,0 +1,37 @@
+#include "FlashStorage.h"
+
+#include <Arduino.h>
+#include <flash_hal.h>
+#include <spi_flash.h>
+
+namespace Config {
+
+FlashStorage::FlashStorage(uint16_t sectorCount)
+    : _sectorCount(sectorCount), _start(FS_PHYS_ADDR + FS_PHYS_SIZE - sectorCount * SPI_FLASH_SEC_SIZE) {
+}
+
+bool FlashStorage::available() const {
+    return FS_PHYS_SIZE >= _sectorCount * SPI_FLASH_SEC_SIZE;
+}
+
+size_t FlashStorage::sectorSize() const {
+    return SPI_FLASH_SEC_SIZE;
+}
+
+uint16_t FlashStorage::sectorCount() const {
+    return available() ? _sectorCount : 0;
+}
+
+bool FlashStorage::read(uint32_t offset, void *data, size_t size) {
+    return ESP.flashRead(_start + offset, reinterpret_cast<uint8_t *>(data), size);
+}
+
+bool FlashStorage::write(uint32_t offset, const void *data, size_t size) {
+    return ESP.flashWrite(_start + offset, reinterpret_cast<const uint8_t *>(data), size);
+}
+
+bool FlashStorage::erase(uint16_t sector) {
+    return ESP.flashEraseSector(_start / SPI_FLASH_SEC_SIZE + sector);
+}
+
+} /* namespace Config */
@@ -0,0 +1,34 @@
+#ifndef CONFIG_FLASHSTORAGE_H_
+#define CONFIG_FLASHSTORAGE_H_
+
+#include <cstdint>
+#include <stddef.h>
+
+#include "Journal.h"
+
+namespace Config {
+
+// journal storage in the last sectors of the flash area reserved for a filesystem, which this firmware doesn't use
+// unlike the EEPROM emulation, there is no RAM copy and nothing is erased behind the caller's back
+class FlashStorage : public Journal::Storage {
+  public:
+    explicit FlashStorage(uint16_t sectorCount = 4);
+
+    // false if the flash layout doesn't reserve enough space
+    bool available() const;
+
+    size_t sectorSize() const override;
+    uint16_t sectorCount() const override;
+
+    bool read(uint32_t offset, void *data, size_t size) override;
+    bool write(uint32_t offset, const void *data, size_t size) override;
+    bool erase(uint16_t sector) override;
+
+  private:
+    uint16_t _sectorCount;
+    uint32_t _start;
+};
+
+} /* namespace Config */
+
+#endif /* CONFIG_FLASHSTORAGE_H_ */
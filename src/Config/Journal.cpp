@@ -0,0 +1,278 @@
+#include "Journal.h"
+
+#include <cstring>
+
+#include "../Util/CRC32.h"
+
+namespace Config {
+
+// storage is read in small, word-aligned chunks to keep the stack usage low
+static const size_t CHUNK_SIZE = 32;
+
+Journal::Journal(Storage &storage, uint32_t magic) : _storage(storage), _magic(magic) {
+}
+
+bool Journal::begin() {
+    _ready = false;
+    for (uint8_t type = 0; type < MAX_TYPES; type++) {
+        _latest[type].valid = false;
+    }
+    _sectorSequence = 0;
+    _recordSequence = 0;
+    _erases = 0;
+    if (_storage.sectorCount() < 2 || _storage.sectorSize() % 4) {
+        return false;
+    }
+
+    // the newest sector holds a copy of every record, unless its compaction was interrupted
+    bool formatted = false;
+    for (uint16_t sector = 0; sector < _storage.sectorCount(); sector++) {
+        _SectorHeader header;
+        if (_readSectorHeader(sector, &header) && header.magic == _magic && (!formatted || header.sequence > _sectorSequence)) {
+            formatted = true;
+            _sector = sector;
+            _sectorSequence = header.sequence;
+        }
+    }
+    if (!formatted) {
+        _ready = _compact();
+        return _ready;
+    }
+
+    // scan the older sectors first, so copies in the newest sector win over their originals
+    for (uint16_t sector = 0; sector < _storage.sectorCount(); sector++) {
+        if (sector != _sector) {
+            _scanSector(sector, false);
+        }
+    }
+    _end = _scanSector(_sector, true);
+    _ready = true;
+
+    // bring records left behind by an interrupted compaction into the newest sector
+    for (uint8_t type = 0; type < MAX_TYPES; type++) {
+        if (_latest[type].valid && _latest[type].offset / _storage.sectorSize() != _sector) {
+            return _compact();
+        }
+    }
+    return true;
+}
+
+bool Journal::read(uint8_t type, void *data, size_t length) {
+    if (!_ready || type >= MAX_TYPES || !_latest[type].valid || _latest[type].length != length) {
+        return false;
+    }
+    uint32_t offset = _latest[type].offset + sizeof(_RecordHeader);
+    uint8_t *p = reinterpret_cast<uint8_t *>(data);
+    uint32_t chunk[CHUNK_SIZE / 4];
+    for (size_t i = 0; i < length; i += CHUNK_SIZE) {
+        size_t size = length - i < CHUNK_SIZE ? length - i : CHUNK_SIZE;
+        if (!_storage.read(offset + i, chunk, (size + 3) & ~3)) {
+            return false;
+        }
+        memcpy(p + i, chunk, size);
+    }
+    return true;
+}
+
+bool Journal::append(uint8_t type, const void *data, size_t length) {
+    if (!_ready || type >= MAX_TYPES || length > 0xffff) {
+        return false;
+    }
+    if (_matches(type, data, length)) {
+        return true;
+    }
+
+    size_t size = _recordSize(length);
+    uint32_t limit = (_sector + 1) * _storage.sectorSize();
+    // the space behind the last valid record may hold the remains of an interrupted write
+    if (_end + size > limit || !_isErased(_end, size)) {
+        if (!_compact()) {
+            return false;
+        }
+        limit = (_sector + 1) * _storage.sectorSize();
+        if (_end + size > limit) {
+            return false;
+        }
+    }
+
+    _RecordHeader header = {type, 0, static_cast<uint16_t>(length), _recordSequence + 1};
+    size_t aligned = length & ~3;
+    uint32_t tail = 0;
+    memcpy(&tail, reinterpret_cast<const uint8_t *>(data) + aligned, length - aligned);
+    Util::CRC32 checksum;
+    checksum.update(&header, sizeof(header)).update(data, aligned);
+    if (aligned < length) {
+        checksum.update(&tail, sizeof(tail));
+    }
+    uint32_t crc = checksum.value();
+
+    // the CRC is written last, so an interrupted write is never mistaken for a valid record
+    uint32_t offset = _end + sizeof(header);
+    if (!_storage.write(_end, &header, sizeof(header)) || (aligned && !_storage.write(offset, data, aligned)) ||
+        (aligned < length && !_storage.write(offset + aligned, &tail, sizeof(tail))) || !_storage.write(_end + size - sizeof(crc), &crc, sizeof(crc))) {
+        // don't append behind a partial record
+        _end = limit;
+        return false;
+    }
+
+    _recordSequence = header.sequence;
+    _latest[type] = {_end, header.sequence, header.length, true};
+    _end += size;
+    return true;
+}
+
+uint32_t Journal::erases() const {
+    return _erases;
+}
+
+uint32_t Journal::_scanSector(uint16_t sector, bool preferNewer) {
+    uint32_t offset = sector * _storage.sectorSize() + sizeof(_SectorHeader);
+    uint32_t limit = (sector + 1) * _storage.sectorSize();
+    _RecordHeader header;
+    while (_checkRecord(offset, limit, &header)) {
+        _Location &latest = _latest[header.type];
+        if (!latest.valid || header.sequence > latest.sequence || (preferNewer && header.sequence == latest.sequence)) {
+            latest = {offset, header.sequence, header.length, true};
+        }
+        if (header.sequence > _recordSequence) {
+            _recordSequence = header.sequence;
+        }
+        offset += _recordSize(header.length);
+    }
+    return offset;
+}
+
+bool Journal::_checkRecord(uint32_t offset, uint32_t limit, _RecordHeader *header) {
+    // erased space doesn't have a valid type
+    if (offset + sizeof(_RecordHeader) > limit || !_storage.read(offset, header, sizeof(_RecordHeader)) || header->type >= MAX_TYPES) {
+        return false;
+    }
+    size_t size = _recordSize(header->length);
+    Util::CRC32 crc;
+    uint32_t expected;
+    if (offset + size > limit || !_crc(offset, size - sizeof(expected), crc) || !_storage.read(offset + size - sizeof(expected), &expected, sizeof(expected))) {
+        return false;
+    }
+    return expected == crc.value();
+}
+
+bool Journal::_crc(uint32_t offset, size_t size, Util::CRC32 &crc) {
+    uint32_t chunk[CHUNK_SIZE / 4];
+    for (size_t i = 0; i < size; i += CHUNK_SIZE) {
+        size_t length = size - i < CHUNK_SIZE ? size - i : CHUNK_SIZE;
+        if (!_storage.read(offset + i, chunk, length)) {
+            return false;
+        }
+        crc.update(chunk, length);
+    }
+    return true;
+}
+
+bool Journal::_matches(uint8_t type, const void *data, size_t length) {
+    if (!_latest[type].valid || _latest[type].length != length) {
+        return false;
+    }
+    uint32_t offset = _latest[type].offset + sizeof(_RecordHeader);
+    const uint8_t *p = reinterpret_cast<const uint8_t *>(data);
+    uint32_t chunk[CHUNK_SIZE / 4];
+    for (size_t i = 0; i < length; i += CHUNK_SIZE) {
+        size_t size = length - i < CHUNK_SIZE ? length - i : CHUNK_SIZE;
+        if (!_storage.read(offset + i, chunk, (size + 3) & ~3) || memcmp(p + i, chunk, size)) {
+            return false;
+        }
+    }
+    return true;
+}
+
+bool Journal::_isErased(uint32_t offset, size_t size) {
+    uint32_t chunk[CHUNK_SIZE / 4];
+    for (size_t i = 0; i < size; i += CHUNK_SIZE) {
+        size_t length = size - i < CHUNK_SIZE ? size - i : CHUNK_SIZE;
+        if (!_storage.read(offset + i, chunk, length)) {
+            return false;
+        }
+        for (size_t j = 0; j < length / 4; j++) {
+            if (chunk[j] != _ERASED) {
+                return false;
+            }
+        }
+    }
+    return true;
+}
+
+bool Journal::_readSectorHeader(uint16_t sector, _SectorHeader *header) {
+    return _storage.read(sector * _storage.sectorSize(), header, sizeof(_SectorHeader));
+}
+
+bool Journal::_holdsLatest(uint16_t sector) const {
+    for (uint8_t type = 0; type < MAX_TYPES; type++) {
+        if (_latest[type].valid && _latest[type].offset / _storage.sectorSize() == sector) {
+            return true;
+        }
+    }
+    return false;
+}
+
+bool Journal::_compact() {
+    // reuse the oldest sector that no current record lives in
+    uint16_t target = _storage.sectorCount();
+    uint32_t targetSequence = 0;
+    for (uint16_t sector = 0; sector < _storage.sectorCount(); sector++) {
+        _SectorHeader header;
+        if ((_sectorSequence && sector == _sector) || _holdsLatest(sector) || !_readSectorHeader(sector, &header)) {
+            continue;
+        }
+        uint32_t sequence = header.magic == _magic ? header.sequence : 0;
+        if (target == _storage.sectorCount() || sequence < targetSequence) {
+            target = sector;
+            targetSequence = sequence;
+        }
+    }
+    if (target == _storage.sectorCount() || !_storage.erase(target)) {
+        return false;
+    }
+    _erases++;
+
+    uint32_t offset = target * _storage.sectorSize();
+    uint32_t limit = offset + _storage.sectorSize();
+    _SectorHeader header = {_magic, _sectorSequence + 1};
+    if (!_storage.write(offset, &header, sizeof(header))) {
+        return false;
+    }
+    _sector = target;
+    _sectorSequence = header.sequence;
+    _end = offset + sizeof(header);
+
+    // copies keep their sequence numbers, so they are recognized as the same version
+    for (uint8_t type = 0; type < MAX_TYPES; type++) {
+        _Location &latest = _latest[type];
+        if (!latest.valid) {
+            continue;
+        }
+        size_t size = _recordSize(latest.length);
+        if (_end + size > limit || !_copy(latest.offset, _end, size)) {
+            _end = limit;
+            return false;
+        }
+        latest.offset = _end;
+        _end += size;
+    }
+    return true;
+}
+
+bool Journal::_copy(uint32_t from, uint32_t to, size_t size) {
+    uint32_t chunk[CHUNK_SIZE / 4];
+    for (size_t i = 0; i < size; i += CHUNK_SIZE) {
+        size_t length = size - i < CHUNK_SIZE ? size - i : CHUNK_SIZE;
+        if (!_storage.read(from + i, chunk, length) || !_storage.write(to + i, chunk, length)) {
+            return false;
+        }
+    }
+    return true;
+}
+
+size_t Journal::_recordSize(size_t length) {
+    return sizeof(_RecordHeader) + ((length + 3) & ~3) + sizeof(uint32_t);
+}
+
+} /* namespace Config */
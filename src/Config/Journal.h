@@ -0,0 +1,101 @@
+#ifndef CONFIG_JOURNAL_H_
+#define CONFIG_JOURNAL_H_
+
+#include <cstdint>
+#include <stddef.h>
+
+#include "../Util/CRC32.h"
+
+namespace Config {
+
+// log-structured record store on a ring of flash sectors
+// every append writes a new version of a record behind the previous ones, so a save doesn't erase anything
+// only when the current sector is full, the oldest sector is erased and the newest version of every record is copied over
+// each record carries a CRC32, a torn write is detected and the previous version is used
+class Journal {
+  public:
+    // erasable, NOR-like storage: erase sets all bytes of a sector to 0xff, writes can only clear bits
+    class Storage {
+      public:
+        virtual ~Storage() {
+        }
+
+        virtual size_t sectorSize() const = 0;
+        virtual uint16_t sectorCount() const = 0;
+
+        // offsets and sizes are multiples of 4
+        virtual bool read(uint32_t offset, void *data, size_t size) = 0;
+        virtual bool write(uint32_t offset, const void *data, size_t size) = 0;
+        virtual bool erase(uint16_t sector) = 0;
+    };
+
+    // types are small numbers chosen by the caller, less than MAX_TYPES
+    static const uint8_t MAX_TYPES = 4;
+
+    Journal(Storage &storage, uint32_t magic);
+
+    // scan the storage for the newest valid version of every record
+    // an unformatted storage is formatted
+    bool begin();
+
+    // copy the newest version of the record into data
+    // fails if there is none, or if it has a different length
+    bool read(uint8_t type, void *data, size_t length);
+
+    // store a new version of the record
+    // nothing is written if the data is unchanged
+    bool append(uint8_t type, const void *data, size_t length);
+
+    // number of sector erases since begin()
+    uint32_t erases() const;
+
+  private:
+    struct _SectorHeader {
+        uint32_t magic;
+        uint32_t sequence;
+    };
+
+    // followed by the data, padded to a multiple of 4, and the CRC32 of header and data
+    struct _RecordHeader {
+        uint8_t type;
+        uint8_t reserved;
+        uint16_t length;
+        uint32_t sequence;
+    };
+
+    struct _Location {
+        uint32_t offset;
+        uint32_t sequence;
+        uint16_t length;
+        bool valid;
+    };
+
+    static const uint32_t _ERASED = 0xffffffff;
+
+    Storage &_storage;
+    uint32_t _magic;
+    bool _ready = false;
+
+    _Location _latest[MAX_TYPES];
+    uint16_t _sector = 0;
+    uint32_t _sectorSequence = 0;
+    uint32_t _recordSequence = 0;
+    uint32_t _end = 0;
+    uint32_t _erases = 0;
+
+    uint32_t _scanSector(uint16_t sector, bool preferNewer);
+    bool _checkRecord(uint32_t offset, uint32_t limit, _RecordHeader *header);
+    bool _crc(uint32_t offset, size_t size, Util::CRC32 &crc);
+    bool _matches(uint8_t type, const void *data, size_t length);
+    bool _isErased(uint32_t offset, size_t size);
+    bool _readSectorHeader(uint16_t sector, _SectorHeader *header);
+    bool _holdsLatest(uint16_t sector) const;
+    bool _compact();
+    bool _copy(uint32_t from, uint32_t to, size_t size);
+
+    static size_t _recordSize(size_t length);
+};
+
+} /* namespace Config */
+
+#endif /* CONFIG_JOURNAL_H_ */
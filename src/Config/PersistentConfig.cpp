@@ -6,9 +6,19 @@
 #include <WString.h>
 #include <cstddef>
 
+#include "../Util/CRC32.h"
+
 namespace Config {
 
-PersistentConfig::PersistentConfig(uint32_t magic) : _magic(magic) {
+PersistentConfig::PersistentConfig(uint32_t magic) : _magic(magic), _journal(_storage, magic) {
+}
+
+const PersistentConfig::Data &PersistentConfig::data() const {
+    return _data;
+}
+
+void PersistentConfig::set(const Data &data) {
+    _data = data;
 }
 
 NetworkConfig PersistentConfig::network() {
@@ -23,44 +33,102 @@ LedConfig PersistentConfig::led() {
     return LedConfig(_data.led);
 }
 
-static uint32_t crc32(const void *data, size_t length) {
-    uint32_t crc = 0xffffffff;
-    const uint8_t *p = reinterpret_cast<const uint8_t *>(data);
-    for (size_t i = length; i; i--, p++) {
-        crc ^= *p;
-        for (int8_t j = 7; j >= 0; j--) {
-            crc = (crc >> 1) ^ (0xEDB88320 & (-(crc & 1)));
-        }
-    }
-    return crc ^ 0xffffffff;
+PlayerCache PersistentConfig::playerCache() {
+    return PlayerCache(_cache.player);
 }
 
+// layout of the EEPROM used by earlier firmware, and as fallback: the cache is stored right behind the configuration
+static const size_t CACHE_OFFSET = sizeof(PersistentConfig::Data);
+static const size_t EEPROM_SIZE = CACHE_OFFSET + sizeof(PersistentConfig::CacheData);
+
 void PersistentConfig::load() {
-    EEPROM.begin(sizeof(_data));
-    EEPROM.get(0, _data);
-    uint32_t checksum = crc32(&_data, offsetof(Data, checksum));
-    if (_data.magic == _magic && _data.checksum == checksum) {
-        Serial.println(F("magic number and checksum match, using configuration from EEPROM"));
+    _journalReady = _journal.begin();
+    if (!_journalReady) {
+        Serial.println(F("configuration journal not available, falling back to EEPROM"));
+    }
+
+    if (_journalReady && _journal.read(_R_CONFIG, &_data, sizeof(_data)) && _data.magic == _magic) {
+        Serial.println(F("magic number matches, using configuration from journal"));
+        if (!_journal.read(_R_CACHE, &_cache, sizeof(_cache)) || _cache.magic != _magic) {
+            playerCache().reset();
+        }
+    } else if (_readEEPROM()) {
+        if (_journalReady) {
+            Serial.println(F("migrating configuration from EEPROM to journal"));
+            _write();
+        }
     } else {
-        Serial.println(F("magic number or checksum mismatch, initializing configuration in EEPROM"));
-        Serial.printf("magic number expected %08X, got %08X\r\n", _magic, _data.magic);
-        Serial.printf("checksum expected %08X, got %08X\r\n", checksum, _data.checksum);
         if (!reset()) {
             while (1) {
                 Serial.println(F("initialization failed, going to sleep forever"));
                 delay(10000);
             }
         }
+        playerCache().reset();
         save();
     }
-    EEPROM.end();
 }
 
 void PersistentConfig::save() {
-    EEPROM.begin(sizeof(_data));
+    _write();
+}
+
+void PersistentConfig::saveDeferred(unsigned long delayMillis) {
+    _savePending = true;
+    _saveRequestedMillis = millis();
+    _saveDelayMillis = delayMillis;
+}
+
+void PersistentConfig::handle() {
+    if (_savePending && millis() - _saveRequestedMillis >= _saveDelayMillis) {
+        Serial.println(F("saving deferred configuration changes"));
+        _write();
+    }
+}
+
+void PersistentConfig::saveCache() {
+    _write();
+}
+
+void PersistentConfig::_write() {
+    // pending changes are included
+    _savePending = false;
+
     _data.magic = _magic;
-    _data.checksum = crc32(&_data, offsetof(Data, checksum));
+    _data.checksum = Util::CRC32::calculate(&_data, offsetof(Data, checksum));
+    _cache.magic = _magic;
+    _cache.checksum = Util::CRC32::calculate(&_cache, offsetof(CacheData, checksum));
+    if (!_journalReady) {
+        _writeEEPROM();
+    } else if (!_journal.append(_R_CONFIG, &_data, sizeof(_data)) || !_journal.append(_R_CACHE, &_cache, sizeof(_cache))) {
+        Serial.println(F("failed to append configuration to journal"));
+    }
+}
+
+bool PersistentConfig::_readEEPROM() {
+    EEPROM.begin(EEPROM_SIZE);
+    EEPROM.get(CACHE_OFFSET, _cache);
+    if (_cache.magic != _magic || _cache.checksum != Util::CRC32::calculate(&_cache, offsetof(CacheData, checksum))) {
+        Serial.println(F("magic number or checksum mismatch, discarding cache"));
+        playerCache().reset();
+    }
+    EEPROM.get(0, _data);
+    EEPROM.end();
+    uint32_t checksum = Util::CRC32::calculate(&_data, offsetof(Data, checksum));
+    if (_data.magic == _magic && _data.checksum == checksum) {
+        Serial.println(F("magic number and checksum match, using configuration from EEPROM"));
+        return true;
+    }
+    Serial.println(F("magic number or checksum mismatch, initializing configuration"));
+    Serial.printf("magic number expected %08X, got %08X\r\n", _magic, _data.magic);
+    Serial.printf("checksum expected %08X, got %08X\r\n", checksum, _data.checksum);
+    return false;
+}
+
+void PersistentConfig::_writeEEPROM() {
+    EEPROM.begin(EEPROM_SIZE);
     EEPROM.put(0, _data);
+    EEPROM.put(CACHE_OFFSET, _cache);
     EEPROM.end();
 }
 
@@ -3,8 +3,11 @@
 
 #include <cstdint>
 
+#include "FlashStorage.h"
+#include "Journal.h"
 #include "LedConfig.h"
 #include "NetworkConfig.h"
+#include "PlayerCache.h"
 #include "SonosConfig.h"
 
 namespace Config {
@@ -19,27 +22,78 @@ class PersistentConfig {
         uint32_t checksum;
     };
 
+    // stored as a separate record, so the configuration layout (and its checksum) is not affected by the cache
+    struct CacheData {
+        uint32_t magic;
+        PlayerCache::Data player;
+        uint32_t checksum;
+    };
+
     explicit PersistentConfig(uint32_t magic = 0x51DEB00B);
 
+    // the storage can't be copied along with the configuration, so edits work on a copy of the data
+    PersistentConfig(const PersistentConfig &) = delete;
+    PersistentConfig &operator=(const PersistentConfig &) = delete;
+
+    // the actual configuration data
+    const Data &data() const;
+
+    // replace the configuration data, e.g. with an edited copy
+    // doesn't save anything
+    void set(const Data &data);
+
     // "views" with validating setters, working on the actual configuration data
     NetworkConfig network();
     SonosConfig sonos();
     LedConfig led();
 
-    // (re-)load configuration from EEPROM
-    // if magic number or checksum don't match, initialize defaults and store in EEPROM
+    // cached state, validated separately from the configuration
+    PlayerCache playerCache();
+
+    // (re-)load configuration from the journal
+    // a configuration stored in EEPROM by earlier firmware is migrated to the journal
+    // if magic number or checksum don't match, initialize defaults and store them
     void load();
 
-    // store configuration in EEPROM
+    // append the configuration to the journal
+    // falls back to EEPROM if the flash layout doesn't leave room for the journal
     void save();
 
+    // store configuration once no further changes came in for delayMillis
+    // a burst of changes (e.g. a brightness slider) is coalesced into a single record
+    void saveDeferred(unsigned long delayMillis = 3000);
+
+    // perform a deferred save when it is due; called from the main loop
+    void handle();
+
+    // store the cache; only records that changed are appended
+    void saveCache();
+
     // reset _data to defaults
-    // doesn't update EEPROM
+    // doesn't save anything
     bool reset();
 
   private:
+    enum _RecordType {
+        _R_CONFIG,
+        _R_CACHE,
+    };
+
     uint32_t _magic;
     Data _data;
+    CacheData _cache;
+
+    FlashStorage _storage;
+    Journal _journal;
+    bool _journalReady = false;
+
+    bool _savePending = false;
+    unsigned long _saveRequestedMillis;
+    unsigned long _saveDelayMillis;
+
+    void _write();
+    bool _readEEPROM();
+    void _writeEEPROM();
 };
 
 } /* namespace Config */
@@ -0,0 +1,38 @@
+#include "PlayerCache.h"
+
+#include <cstring>
+
+namespace Config {
+
+PlayerCache::PlayerCache(Data &data) : _data(data) {
+}
+
+bool PlayerCache::lookup(const char *roomUuid, IPAddress *playerIP) const {
+    if (!_data.playerIP || !*roomUuid || std::strncmp(_data.roomUuid, roomUuid, sizeof(_data.roomUuid))) {
+        return false;
+    }
+    *playerIP = IPAddress(_data.playerIP);
+    return true;
+}
+
+bool PlayerCache::set(const char *roomUuid, const IPAddress &playerIP) {
+    if (strlen(roomUuid) >= sizeof(_data.roomUuid)) {
+        return false;
+    }
+    uint32_t ip = playerIP;
+    if (ip != _data.playerIP || strcmp(_data.roomUuid, roomUuid)) {
+        strcpy(_data.roomUuid, roomUuid);
+        _data.playerIP = ip;
+        _data.generation++;
+    }
+    return true;
+}
+
+bool PlayerCache::reset() {
+    _data.roomUuid[0] = '\0';
+    _data.playerIP = 0;
+    _data.generation = 0;
+    return true;
+}
+
+} /* namespace Config */
@@ -0,0 +1,36 @@
+#ifndef CONFIG_PLAYERCACHE_H_
+#define CONFIG_PLAYERCACHE_H_
+
+#include <IPAddress.h>
+#include <cstdint>
+
+namespace Config {
+
+// last resolved player of the configured room
+// allows a warm boot to subscribe directly, without SSDP discovery and topology lookup
+class PlayerCache {
+  public:
+    struct Data {
+        char roomUuid[32];
+        uint32_t playerIP;
+        // incremented whenever the cached player changes; there is no wall clock to take a timestamp from
+        uint32_t generation;
+    };
+
+    explicit PlayerCache(Data &data);
+
+    // if the cache holds a player for the given room, store its IP address in *playerIP
+    bool lookup(const char *roomUuid, IPAddress *playerIP) const;
+
+    // the generation is only incremented if the cached player actually changes
+    bool set(const char *roomUuid, const IPAddress &playerIP);
+
+    bool reset();
+
+  private:
+    Data &_data;
+};
+
+} /* namespace Config */
+
+#endif /* CONFIG_PLAYERCACHE_H_ */
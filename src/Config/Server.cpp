@@ -9,8 +9,8 @@
 #include <HardwareSerial.h>
 #include <Updater.h>
 
-#include "../Sonos/Discover.h"
-#include "../Sonos/ZoneGroupTopology.h"
+#include "../HTTP/BufferedResponse.h"
+#include "../Sonos/RoomDirectory.h"
 
 #include "LedConfig.h"
 #include "NetworkConfig.h"
@@ -18,10 +18,11 @@
 
 namespace Config {
 
-Server::Server(PersistentConfig &config, IPAddress addr, uint16_t port) : _config(config), _server(addr, port) {
+Server::Server(PersistentConfig &config, Sonos::RoomDirectory &roomDirectory, IPAddress addr, uint16_t port)
+    : _config(config), _roomDirectory(roomDirectory), _server(addr, port) {
 }
 
-Server::Server(PersistentConfig &config, uint16_t port) : _config(config), _server(port) {
+Server::Server(PersistentConfig &config, Sonos::RoomDirectory &roomDirectory, uint16_t port) : _config(config), _roomDirectory(roomDirectory), _server(port) {
 }
 
 void Server::begin() {
@@ -34,6 +35,9 @@ void Server::begin() {
     _server.on("/api/config/sonos", HTTP_POST, std::bind(&Server::_handlePostApiConfigSonos, this));
     _server.on("/api/config/led", HTTP_GET, std::bind(&Server::_handleGetApiConfigLed, this));
     _server.on("/api/config/led", HTTP_POST, std::bind(&Server::_handlePostApiConfigLed, this));
+    _server.on("/api/update", HTTP_POST, std::bind(&Server::_handlePostApiUpdate, this), std::bind(&Server::_handlePostApiUpdateUpload, this));
+    const char *headerKeys[] = {"If-None-Match"};
+    _server.collectHeaders(headerKeys, 1);
     _server.begin();
 }
 
@@ -69,6 +73,18 @@ void Server::onAfterLedConfigChange(Callback callback) {
     _afterLedConfigChangeCallback = callback;
 }
 
+void Server::onBeforeUpdate(Callback callback) {
+    _beforeUpdateCallback = callback;
+}
+
+void Server::onAfterUpdate(UpdateCallback callback) {
+    _afterUpdateCallback = callback;
+}
+
+void Server::onInfo(InfoCallback callback) {
+    _infoCallback = callback;
+}
+
 void Server::_handleGetApiInfo() {
     JsonDocument doc;
     doc[F("boot-mode")] = ESP.getBootMode();
@@ -90,6 +106,9 @@ void Server::_handleGetApiInfo() {
     doc[F("sdk-version")] = ESP.getSdkVersion();
     doc[F("sketch-md5")] = ESP.getSketchMD5();
     doc[F("sketch-size")] = ESP.getSketchSize();
+    if (_infoCallback) {
+        _infoCallback(doc.as<JsonObject>());
+    }
     _sendResponseJson(200, doc);
 }
 
@@ -116,28 +135,50 @@ void Server::_handleGetApiDiscoverNetworks() {
 
 void Server::_handleGetApiDiscoverRooms() {
     JsonDocument doc;
-    IPAddress addr;
-    if (Sonos::Discover::any(&addr)) {
-        Sonos::ZoneGroupTopology topo(addr);
-
-        JsonArray rooms = doc.to<JsonArray>();
-        bool discoverResult = topo.GetZoneGroupState_Decoded([rooms](Sonos::ZoneInfo info) {
-            JsonObject room = rooms.add<JsonObject>();
-            room[F("uuid")] = info.uuid;
-            room[F("name")] = info.name;
-            room[F("ip")] = info.playerIP.toString();
-        });
-
-        if (discoverResult) {
-            _sendResponseJson(200, doc);
-        } else {
+
+    // rooms are never discovered here, the directory is filled from the main loop
+    if (!_roomDirectory.fresh()) {
+        _roomDirectory.requestRefresh();
+    }
+
+    if (!_roomDirectory.valid()) {
+        switch (_roomDirectory.error()) {
+        case Sonos::RoomDirectory::NO_DEVICES_FOUND:
+            doc[F("error")] = F("No Devices Found");
+            _sendResponseJson(404, doc);
+            break;
+        case Sonos::RoomDirectory::DECODING_FAILED:
             doc[F("error")] = F("Error Decoding Discovery Response");
             _sendResponseJson(500, doc);
+            break;
+        case Sonos::RoomDirectory::NONE:
+            doc[F("error")] = F("Discovery In Progress");
+            _sendResponseJson(503, doc, F("Retry-After: 2\r\n"));
+            break;
         }
-    } else {
-        doc[F("error")] = F("No Devices Found");
-        _sendResponseJson(404, doc);
+        return;
     }
+
+    // derived from the rooms themselves, so a tag from before a reboot doesn't match different rooms
+    String etag = String('"') + String(static_cast<unsigned long>(_roomDirectory.checksum()), 16) + '"';
+    String headers = String(F("ETag: ")) + etag + F("\r\nAge: ") + _roomDirectory.ageMillis() / 1000 + F("\r\n");
+
+    if (_server.header(F("If-None-Match")) == etag) {
+        // a single write, so the response isn't split into small segments
+        auto client = _server.client();
+        client.print(String(F("HTTP/1.1 304 Not Modified\r\n")) + headers + F("Connection: close\r\n\r\n"));
+        client.stop();
+        return;
+    }
+
+    JsonArray rooms = doc.to<JsonArray>();
+    for (const Sonos::ZoneInfo &info : _roomDirectory.rooms()) {
+        JsonObject room = rooms.add<JsonObject>();
+        room[F("uuid")] = info.uuid;
+        room[F("name")] = info.name;
+        room[F("ip")] = info.playerIP.toString();
+    }
+    _sendResponseJson(200, doc, headers);
 }
 
 void Server::_handleGetApiConfigNetwork() {
@@ -145,8 +186,8 @@ void Server::_handleGetApiConfigNetwork() {
 }
 
 void Server::_handlePostApiConfigNetwork() {
-    PersistentConfig copy = _config;
-    NetworkConfig networkConfig = copy.network();
+    PersistentConfig::Data copy = _config.data();
+    NetworkConfig networkConfig(copy.network);
 
     if (_handleArg(F("ssid"), networkConfig, &NetworkConfig::setSsid) && _handleArg(F("passphrase"), networkConfig, &NetworkConfig::setPassphrase) &&
         _handleArg(F("hostname"), networkConfig, &NetworkConfig::setHostname)) {
@@ -156,7 +197,7 @@ void Server::_handlePostApiConfigNetwork() {
             }
 
             // copy modifications back and save
-            _config = copy;
+            _config.set(copy);
             _config.save();
 
             _sendResponseNetwork(200);
@@ -177,8 +218,8 @@ void Server::_handleGetApiConfigSonos() {
 }
 
 void Server::_handlePostApiConfigSonos() {
-    PersistentConfig copy = _config;
-    SonosConfig sonosConfig = copy.sonos();
+    PersistentConfig::Data copy = _config.data();
+    SonosConfig sonosConfig(copy.sonos);
 
     if (_handleArg(F("active"), sonosConfig, &SonosConfig::setActive) && _handleArg(F("room-uuid"), sonosConfig, &SonosConfig::setRoomUuid)) {
         if (sonosConfig != _config.sonos()) {
@@ -187,7 +228,7 @@ void Server::_handlePostApiConfigSonos() {
             }
 
             // copy modifications back and save
-            _config = copy;
+            _config.set(copy);
             _config.save();
 
             _sendResponseSonos(200);
@@ -208,8 +249,8 @@ void Server::_handleGetApiConfigLed() {
 }
 
 void Server::_handlePostApiConfigLed() {
-    PersistentConfig copy = _config;
-    LedConfig ledConfig = copy.led();
+    PersistentConfig::Data copy = _config.data();
+    LedConfig ledConfig(copy.led);
 
     if (_handleArg(F("brightness"), ledConfig, &LedConfig::setBrightness) && _handleArg(F("transform"), ledConfig, &LedConfig::setTransform)) {
         if (ledConfig != _config.led()) {
@@ -217,9 +258,9 @@ void Server::_handlePostApiConfigLed() {
                 _beforeLedConfigChangeCallback();
             }
 
-            // copy modifications back and save
-            _config = copy;
-            _config.save();
+            // copy modifications back, saving is deferred because brightness is often tuned in several steps
+            _config.set(copy);
+            _config.saveDeferred();
 
             _sendResponseLed(200);
 
@@ -234,6 +275,139 @@ void Server::_handlePostApiConfigLed() {
     }
 }
 
+static String toHex(const uint8_t *data, size_t length) {
+    String hex;
+    hex.reserve(2 * length);
+    for (size_t i = 0; i < length; i++) {
+        hex += "0123456789abcdef"[data[i] >> 4];
+        hex += "0123456789abcdef"[data[i] & 0xf];
+    }
+    return hex;
+}
+
+// progress is logged in steps of this many bytes
+static const size_t UPDATE_REPORT_STEP = 64 * 1024;
+
+void Server::_handlePostApiUpdate() {
+    JsonDocument doc;
+    if (!_updateStarted) {
+        doc[F("error")] = F("No Firmware Uploaded");
+        _sendResponseJson(400, doc);
+        return;
+    }
+    _updateStarted = false;
+
+    bool success = !_updateErrorCode;
+    doc[F("success")] = success;
+    if (success) {
+        doc[F("size")] = _updateSize;
+        doc[F("millis")] = _updateMillis;
+        doc[F("bytes-per-second")] = _updateMillis ? static_cast<uint32_t>(1000ULL * _updateSize / _updateMillis) : 0;
+        doc[F("md5")] = Update.md5String();
+        doc[F("sha256")] = _updateActualSha256;
+        _sendResponseJson(200, doc);
+    } else {
+        doc[F("error")] = _updateError;
+        _sendResponseJson(_updateErrorCode, doc);
+    }
+
+    if (_afterUpdateCallback) {
+        _afterUpdateCallback(success);
+    }
+}
+
+void Server::_handlePostApiUpdateUpload() {
+    HTTPUpload &upload = _server.upload();
+
+    switch (upload.status) {
+    case UPLOAD_FILE_START: {
+        _updateStarted = true;
+        _updateErrorCode = 0;
+        _updateError = String();
+        _updateActualSha256 = String();
+        _updateStartMillis = millis();
+        _updateMillis = 0;
+        _updateSize = 0;
+        _updateReportedSize = 0;
+        br_sha256_init(&_updateSha256);
+
+        if (_beforeUpdateCallback) {
+            _beforeUpdateCallback();
+        }
+
+        Serial.printf_P(PSTR("update: receiving %s\r\n"), upload.filename.c_str());
+        // the actual size is only known at the end, so the whole free space is reserved
+        // this way, end(false) discards an incomplete or unverified image instead of activating it
+        uint32_t maxSize = (ESP.getFreeSketchSpace() - 0x1000) & 0xFFFFF000;
+        // begin() resets the expected MD5, so it is only set afterwards
+        if (_server.hasArg(F("sha256")) && _server.arg(F("sha256")).length() != 2 * br_sha256_SIZE) {
+            _failUpdate(400, F("Invalid SHA256"));
+        } else if (!Update.begin(maxSize, U_FLASH)) {
+            _failUpdate(500, Update.getErrorString());
+        } else if (_server.hasArg(F("md5")) && !Update.setMD5(_server.arg(F("md5")).c_str())) {
+            _failUpdate(400, F("Invalid MD5"));
+        }
+        _updateExpectedSha256 = _server.arg(F("sha256"));
+        _updateExpectedSha256.toLowerCase();
+        break;
+    }
+    case UPLOAD_FILE_WRITE:
+        if (_updateErrorCode) {
+            break;
+        }
+        // chunks are written to flash as they arrive, both hashes are calculated on the way
+        br_sha256_update(&_updateSha256, upload.buf, upload.currentSize);
+        if (Update.write(upload.buf, upload.currentSize) != upload.currentSize) {
+            _failUpdate(500, Update.getErrorString());
+            break;
+        }
+        if (upload.totalSize - _updateReportedSize >= UPDATE_REPORT_STEP) {
+            _updateReportedSize = upload.totalSize;
+            unsigned long elapsedMillis = millis() - _updateStartMillis;
+            unsigned long contentLength = _server.clientContentLength();
+            Serial.printf_P(PSTR("update: %u of %lu bytes, %lu bytes/s\r\n"), upload.totalSize, contentLength,
+                            elapsedMillis ? static_cast<unsigned long>(1000ULL * upload.totalSize / elapsedMillis) : 0);
+        }
+        break;
+    case UPLOAD_FILE_END: {
+        if (_updateErrorCode) {
+            break;
+        }
+        uint8_t digest[br_sha256_SIZE];
+        br_sha256_out(&_updateSha256, digest);
+        _updateActualSha256 = toHex(digest, sizeof(digest));
+        if (_updateExpectedSha256.length() && _updateActualSha256 != _updateExpectedSha256) {
+            _failUpdate(400, F("SHA256 Mismatch"));
+            break;
+        }
+        // verifies the MD5, if one was given, and activates the new image
+        if (!Update.end(true)) {
+            _failUpdate(400, Update.getErrorString());
+            break;
+        }
+        _updateMillis = millis() - _updateStartMillis;
+        _updateSize = upload.totalSize;
+        Serial.printf_P(PSTR("update: %u bytes in %lu ms\r\n"), upload.totalSize, _updateMillis);
+        break;
+    }
+    case UPLOAD_FILE_ABORTED:
+        if (!_updateErrorCode) {
+            _failUpdate(400, F("Upload Aborted"));
+        }
+        break;
+    }
+}
+
+void Server::_failUpdate(int code, const String &error) {
+    Serial.print(F("update failed: "));
+    Serial.println(error);
+    _updateErrorCode = code;
+    _updateError = error;
+    if (Update.isRunning()) {
+        Update.end(false);
+    }
+}
+
 void Server::_sendResponseNetwork(int code) {
     const NetworkConfig &networkConfig = _config.network();
 
@@ -290,19 +464,22 @@ void Server::_sendResponseLed(int code) {
     _sendResponseJson(code, doc);
 }
 
-void Server::_sendResponseJson(int code, JsonVariantConst source) {
+void Server::_sendResponseJson(int code, JsonVariantConst source, const String &headers) {
     auto client = _server.client();
 
-    client.print(F("HTTP/1.1 "));
-    client.print(code);
-    client.print(' ');
-    client.println(_server.responseCodeToString(code));
-    client.println(F("Content-Type: application/json"));
-    client.print(F("Content-Length: "));
-    client.println(measureJsonPretty(source));
-    client.println(F("Connection: close"));
-    client.println();
-    serializeJsonPretty(source, client);
+    String head = String(F("HTTP/1.1 ")) + code + ' ' + _server.responseCodeToString(code) + F("\r\n");
+    head += F("Content-Type: application/json\r\n");
+    head += headers;
+    head += F("Connection: close\r\n");
+
+    // serialized once into the response buffer, which also determines the length
+    HTTP::BufferedResponse response(client, head);
+    if (_server.hasArg(F("compact"))) {
+        serializeJson(source, response);
+    } else {
+        serializeJsonPretty(source, response);
+    }
+    response.end();
 
     client.stop();
 }
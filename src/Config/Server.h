@@ -5,9 +5,11 @@
 #include <ESP8266WebServer.h>
 #include <IPAddress.h>
 #include <WString.h>
+#include <bearssl/bearssl_hash.h>
 #include <cstdint>
 #include <functional>
 
+#include "../Sonos/RoomDirectory.h"
 #include "PersistentConfig.h"
 
 namespace Config {
@@ -17,9 +19,11 @@ class PersistentConfig;
 class Server {
   public:
     typedef std::function<void()> Callback;
+    typedef std::function<void(JsonObject info)> InfoCallback;
+    typedef std::function<void(bool success)> UpdateCallback;
 
-    explicit Server(PersistentConfig &config, IPAddress addr, uint16_t port = 80);
-    explicit Server(PersistentConfig &config, uint16_t port = 80);
+    explicit Server(PersistentConfig &config, Sonos::RoomDirectory &roomDirectory, IPAddress addr, uint16_t port = 80);
+    explicit Server(PersistentConfig &config, Sonos::RoomDirectory &roomDirectory, uint16_t port = 80);
 
     void begin();
     void handleClient();
@@ -37,8 +41,18 @@ class Server {
     void onBeforeLedConfigChange(Callback callback);
     void onAfterLedConfigChange(Callback callback);
 
+    // set firmware update callbacks
+    // the upload is handled within handleClient(), the before callback is the last chance to quiesce the application
+    // after a successful update, the response has been sent and the device is expected to restart
+    void onBeforeUpdate(Callback callback);
+    void onAfterUpdate(UpdateCallback callback);
+
+    // set callback for adding application-specific values to /api/info
+    void onInfo(InfoCallback callback);
+
   private:
     PersistentConfig &_config;
+    Sonos::RoomDirectory &_roomDirectory;
 
     ESP8266WebServer _server;
 
@@ -51,6 +65,23 @@ class Server {
     Callback _beforeLedConfigChangeCallback;
     Callback _afterLedConfigChangeCallback;
 
+    Callback _beforeUpdateCallback;
+    UpdateCallback _afterUpdateCallback;
+
+    InfoCallback _infoCallback;
+
+    // state of the firmware upload in progress; the first error sticks
+    bool _updateStarted = false;
+    int _updateErrorCode;
+    String _updateError;
+    String _updateExpectedSha256;
+    br_sha256_context _updateSha256;
+    String _updateActualSha256;
+    unsigned long _updateStartMillis;
+    unsigned long _updateMillis;
+    size_t _updateSize;
+    size_t _updateReportedSize;
+
     void _handleGetApiInfo();
 
     void _handleGetApiDiscoverNetworks();
@@ -65,12 +96,14 @@ class Server {
 
     void _handlePostApiUpdate();
     void _handlePostApiUpdateUpload();
+    void _failUpdate(int code, const String &error);
 
     void _sendResponseNetwork(int code);
     void _sendResponseSonos(int code);
     void _sendResponseLed(int code);
 
-    void _sendResponseJson(int code, JsonVariantConst source);
+    // headers are passed verbatim, each line terminated by CRLF
+    void _sendResponseJson(int code, JsonVariantConst source, const String &headers = String());
 
     // extract the request argument, call a specialization of _convert(), and pass the result to the setter
     template <typename C, typename T> bool _handleArg(const String &name, C &config, bool (C::*setter)(T));
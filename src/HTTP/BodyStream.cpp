@@ -0,0 +1,67 @@
+#include "BodyStream.h"
+
+#include <algorithm>
+
+namespace HTTP {
+
+BodyStream::BodyStream(Stream &stream, int length) : _stream(stream), _remaining(length) {
+    setTimeout(stream.getTimeout());
+}
+
+int BodyStream::available() {
+    int available = _stream.available();
+    return _remaining < 0 ? available : std::min(available, _remaining);
+}
+
+int BodyStream::read() {
+    if (!_remaining) {
+        return -1;
+    }
+    int ch = _stream.read();
+    if (ch >= 0 && _remaining > 0) {
+        _remaining--;
+    }
+    return ch;
+}
+
+int BodyStream::peek() {
+    return _remaining ? _stream.peek() : -1;
+}
+
+size_t BodyStream::readBytes(char *buffer, size_t length) {
+    if (_remaining >= 0) {
+        length = std::min(length, static_cast<size_t>(_remaining));
+    }
+    if (!length) {
+        return 0;
+    }
+    size_t count = _stream.readBytes(buffer, length);
+    if (_remaining > 0) {
+        _remaining -= count;
+    }
+    return count;
+}
+
+size_t BodyStream::write(uint8_t) {
+    return 0;
+}
+
+int BodyStream::remaining() const {
+    return _remaining;
+}
+
+bool BodyStream::drain() {
+    if (_remaining < 0) {
+        // unknown length, the end of the body can't be detected
+        return false;
+    }
+    char buffer[64];
+    while (_remaining > 0) {
+        if (!readBytes(buffer, sizeof(buffer))) {
+            return false;
+        }
+    }
+    return true;
+}
+
+} // namespace HTTP
@@ -0,0 +1,37 @@
+#ifndef HTTP_BODYSTREAM_H_
+#define HTTP_BODYSTREAM_H_
+
+#include <Stream.h>
+#include <cstddef>
+#include <cstdint>
+
+namespace HTTP {
+
+// stream view on a response body, limited to its Content-Length
+// parsers can't read into the next response on a keep-alive connection, and don't wait for data that never comes
+class BodyStream : public Stream {
+  public:
+    // length is the Content-Length, or -1 if unknown (then reads are not limited)
+    BodyStream(Stream &stream, int length);
+
+    int available() override;
+    int read() override;
+    int peek() override;
+    size_t readBytes(char *buffer, size_t length) override;
+    size_t write(uint8_t) override;
+
+    // number of body bytes not read yet, -1 if the length is unknown
+    int remaining() const;
+
+    // consume the rest of the body (using timed reads)
+    // returns true if the body has been consumed completely, so the connection can be reused
+    bool drain();
+
+  private:
+    Stream &_stream;
+    int _remaining;
+};
+
+} // namespace HTTP
+
+#endif /* HTTP_BODYSTREAM_H_ */
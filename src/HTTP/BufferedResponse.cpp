@@ -0,0 +1,97 @@
+#include "BufferedResponse.h"
+
+#include <algorithm>
+#include <cstdio>
+#include <cstring>
+#include <pgmspace.h>
+
+namespace HTTP {
+
+static const char TRANSFER_ENCODING_CHUNKED[] PROGMEM = "Transfer-Encoding: chunked\r\n\r\n";
+static const char LAST_CHUNK[] PROGMEM = "0\r\n\r\n";
+
+uint8_t BufferedResponse::_buffer[_PREFIX_SIZE + _CHUNK_SIZE + _SUFFIX_SIZE];
+
+BufferedResponse::BufferedResponse(Print &out, const String &head) : _out(out), _head(head) {
+}
+
+size_t BufferedResponse::write(uint8_t ch) {
+    if (_length == _CHUNK_SIZE) {
+        _sendChunk(false);
+    }
+    _buffer[_PREFIX_SIZE + _length++] = ch;
+    return 1;
+}
+
+size_t BufferedResponse::write(const uint8_t *data, size_t size) {
+    size_t remaining = size;
+    while (remaining) {
+        if (_length == _CHUNK_SIZE) {
+            _sendChunk(false);
+        }
+        size_t length = std::min(remaining, _CHUNK_SIZE - _length);
+        memcpy(_buffer + _PREFIX_SIZE + _length, data, length);
+        _length += length;
+        data += length;
+        remaining -= length;
+    }
+    return size;
+}
+
+void BufferedResponse::end() {
+    if (_chunked) {
+        _sendChunk(true);
+    } else {
+        // the whole body is known, so its length can be announced
+        char contentLength[40];
+        size_t start = _PREFIX_SIZE;
+        _prepend(&start, contentLength, snprintf_P(contentLength, sizeof(contentLength), PSTR("Content-Length: %u\r\n\r\n"), static_cast<unsigned int>(_length)));
+        if (!_prepend(&start, _head.c_str(), _head.length())) {
+            _out.print(_head);
+        }
+        _out.write(_buffer + start, _PREFIX_SIZE - start + _length);
+    }
+    _length = 0;
+}
+
+bool BufferedResponse::chunked() const {
+    return _chunked;
+}
+
+void BufferedResponse::_sendChunk(bool last) {
+    // frame the payload in place, so the whole chunk goes out in a single write, the first one together with the head
+    size_t start = _PREFIX_SIZE;
+    size_t end = _PREFIX_SIZE + _length;
+    if (_length) {
+        char sizeLine[12];
+        _prepend(&start, sizeLine, snprintf_P(sizeLine, sizeof(sizeLine), PSTR("%X\r\n"), static_cast<unsigned int>(_length)));
+        memcpy(_buffer + end, "\r\n", 2);
+        end += 2;
+    }
+    if (last) {
+        memcpy_P(_buffer + end, LAST_CHUNK, sizeof(LAST_CHUNK) - 1);
+        end += sizeof(LAST_CHUNK) - 1;
+    }
+    if (!_chunked) {
+        char transferEncoding[sizeof(TRANSFER_ENCODING_CHUNKED)];
+        memcpy_P(transferEncoding, TRANSFER_ENCODING_CHUNKED, sizeof(transferEncoding));
+        _prepend(&start, transferEncoding, sizeof(transferEncoding) - 1);
+        if (!_prepend(&start, _head.c_str(), _head.length())) {
+            _out.print(_head);
+        }
+        _chunked = true;
+    }
+    _out.write(_buffer + start, end - start);
+    _length = 0;
+}
+
+bool BufferedResponse::_prepend(size_t *start, const char *text, size_t length) {
+    if (length > *start) {
+        return false;
+    }
+    *start -= length;
+    memcpy(_buffer + *start, text, length);
+    return true;
+}
+
+} // namespace HTTP
@@ -0,0 +1,52 @@
+#ifndef HTTP_BUFFEREDRESPONSE_H_
+#define HTTP_BUFFEREDRESPONSE_H_
+
+#include <Print.h>
+#include <WString.h>
+#include <cstddef>
+#include <cstdint>
+
+namespace HTTP {
+
+// collects a response body in a fixed buffer and sends it in full-size segments
+// if the whole body fits into the buffer, it is sent with a Content-Length; otherwise, chunked transfer encoding is used
+// the head goes out in the same write as the body (or its first chunk), so there are no small segments for Nagle to hold back
+// the body is only generated once, no need to measure it up front
+class BufferedResponse : public Print {
+  public:
+    // head is the status line and the headers, each terminated by CRLF, without the empty line that ends the head
+    BufferedResponse(Print &out, const String &head);
+
+    size_t write(uint8_t ch) override;
+    size_t write(const uint8_t *data, size_t size) override;
+
+    // send the rest of the response
+    void end();
+
+    // whether the response is sent with chunked transfer encoding
+    bool chunked() const;
+
+  private:
+    // payload of a chunk; with the chunk framing, it still fits into a single TCP segment
+    static const size_t _CHUNK_SIZE = 1400;
+    // room in front of the payload for the head and the chunk size line; a longer head is sent on its own
+    static const size_t _PREFIX_SIZE = 512;
+    // room behind the payload for the CRLF ending a chunk, and the last chunk
+    static const size_t _SUFFIX_SIZE = 7;
+
+    // shared by all responses, which are sent one at a time
+    static uint8_t _buffer[_PREFIX_SIZE + _CHUNK_SIZE + _SUFFIX_SIZE];
+
+    Print &_out;
+    String _head;
+    size_t _length = 0;
+    bool _chunked = false;
+
+    void _sendChunk(bool last);
+    // put text in front of the data starting at _buffer + *start; false if there is no room left
+    bool _prepend(size_t *start, const char *text, size_t length);
+};
+
+} // namespace HTTP
+
+#endif /* HTTP_BUFFEREDRESPONSE_H_ */
@@ -0,0 +1,137 @@
+#include "ConnectionPool.h"
+
+#include <Arduino.h>
+#include <HardwareSerial.h>
+
+namespace HTTP {
+
+ConnectionPool connectionPool;
+
+ConnectionPool::ConnectionPool(unsigned long idleTimeoutMillis) : _idleTimeoutMillis(idleTimeoutMillis) {
+}
+
+HTTPClient *ConnectionPool::acquire(const IPAddress &host, uint16_t port, const String &uri) {
+    evictIdle();
+
+    // prefer an open connection to the same host, then a closed one, then the least recently used one
+    _Connection *candidate = nullptr;
+    for (_Connection &connection : _connections) {
+        if (connection.inUse) {
+            continue;
+        }
+        if (connection.host == host && connection.port == port && connection.http.connected()) {
+            candidate = &connection;
+            break;
+        }
+        if (!candidate || (candidate->http.connected() && !connection.http.connected()) ||
+            (candidate->http.connected() == connection.http.connected() && connection.lastUsedMillis < candidate->lastUsedMillis)) {
+            candidate = &connection;
+        }
+    }
+
+    if (!candidate) {
+        Serial.println(F("No free connection in pool"));
+        return nullptr;
+    }
+
+    // HTTPClient keeps the connection open after end() if the server agrees to keep-alive
+    candidate->http.setReuse(true);
+    if (candidate->host == host && candidate->port == port && candidate->http.connected()) {
+        // begin() would replace the underlying client, so only the path is updated
+        // a closed connection has lost its client, though, and starts over below
+        if (!candidate->http.setURL(uri)) {
+            return nullptr;
+        }
+    } else {
+        _close(*candidate);
+        candidate->host = host;
+        candidate->port = port;
+        candidate->http.setReuse(true);
+        if (!candidate->http.begin(candidate->wifiClient, host.toString(), port, uri)) {
+            candidate->port = 0;
+            return nullptr;
+        }
+    }
+
+    candidate->inUse = true;
+    return &candidate->http;
+}
+
+HTTPClient *ConnectionPool::acquire(const String &url) {
+    IPAddress host;
+    uint16_t port;
+    String path;
+    if (!parseURL(url, &host, &port, &path)) {
+        return nullptr;
+    }
+    return acquire(host, port, path);
+}
+
+void ConnectionPool::release(HTTPClient *client, bool reusable) {
+    for (_Connection &connection : _connections) {
+        if (&connection.http == client) {
+            if (!reusable) {
+                connection.http.setReuse(false);
+            }
+            connection.http.end();
+            connection.inUse = false;
+            connection.lastUsedMillis = millis();
+            return;
+        }
+    }
+}
+
+void ConnectionPool::evictIdle() {
+    unsigned long now = millis();
+    for (_Connection &connection : _connections) {
+        if (!connection.inUse && connection.http.connected() && now - connection.lastUsedMillis >= _idleTimeoutMillis) {
+            _close(connection);
+        }
+    }
+}
+
+void ConnectionPool::closeAll() {
+    for (_Connection &connection : _connections) {
+        if (!connection.inUse) {
+            _close(connection);
+        }
+    }
+}
+
+void ConnectionPool::_close(_Connection &connection) {
+    connection.http.setReuse(false);
+    connection.http.end();
+}
+
+bool parseURL(const String &url, IPAddress *host, uint16_t *port, String *path) {
+    if (!url.startsWith(F("http://"))) {
+        Serial.println(F("Only http:// URLs can be pooled"));
+        return false;
+    }
+
+    int hostStart = 7;
+    int pathStart = url.indexOf('/', hostStart);
+    if (pathStart < 0) {
+        pathStart = url.length();
+    }
+    int portStart = url.indexOf(':', hostStart);
+    *port = 80;
+    if (portStart >= 0 && portStart < pathStart) {
+        *port = url.substring(portStart + 1, pathStart).toInt();
+    } else {
+        portStart = pathStart;
+    }
+
+    if (!host->fromString(url.substring(hostStart, portStart))) {
+        Serial.println(F("Only URLs with an IP address can be pooled"));
+        return false;
+    }
+
+    *path = url.substring(pathStart);
+    if (!path->length()) {
+        *path = String('/');
+    }
+    return true;
+}
+
+} // namespace HTTP
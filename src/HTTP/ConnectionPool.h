@@ -0,0 +1,62 @@
+#ifndef HTTP_CONNECTIONPOOL_H_
+#define HTTP_CONNECTIONPOOL_H_
+
+#include <ESP8266HTTPClient.h>
+#include <IPAddress.h>
+#include <WString.h>
+#include <WiFiClient.h>
+#include <cstdint>
+
+namespace HTTP {
+
+// small pool of keep-alive HTTP connections, keyed by host IP and port
+// saves the TCP handshake for consecutive requests to the same player
+class ConnectionPool {
+  public:
+    explicit ConnectionPool(unsigned long idleTimeoutMillis = 5000);
+
+    // prepare an HTTP client for a request to the given host, reusing an idle connection to it if there is one
+    // returns nullptr if all connections are in use
+    // the client must be handed back via release() once the response has been consumed
+    HTTPClient *acquire(const IPAddress &host, uint16_t port, const String &uri);
+
+    // same as above, with host, port and path taken from an "http://<ip>[:<port>]/<path>" URL
+    HTTPClient *acquire(const String &url);
+
+    // hand back a client obtained from acquire()
+    // if reusable is false (e.g. because the response body has not been consumed completely), the connection is closed
+    void release(HTTPClient *client, bool reusable = true);
+
+    // close connections that have been idle for longer than the idle timeout
+    void evictIdle();
+
+    // close all idle connections
+    void closeAll();
+
+  private:
+    struct _Connection {
+        IPAddress host;
+        uint16_t port = 0;
+        WiFiClient wifiClient;
+        HTTPClient http;
+        bool inUse = false;
+        unsigned long lastUsedMillis = 0;
+    };
+
+    static const uint8_t _CAPACITY = 4;
+
+    unsigned long _idleTimeoutMillis;
+    _Connection _connections[_CAPACITY];
+
+    void _close(_Connection &connection);
+};
+
+// shared by all SOAP and GENA requests
+extern ConnectionPool connectionPool;
+
+// split an "http://<ip>[:<port>]/<path>" URL, as used for pooled connections
+bool parseURL(const String &url, IPAddress *host, uint16_t *port, String *path);
+
+} // namespace HTTP
+
+#endif /* HTTP_CONNECTIONPOOL_H_ */
@@ -1,28 +1,50 @@
-#include "../UPnP/Discover.h"
 #include "Discover.h"
 
+#include <Arduino.h>
 #include <IPAddress.h>
 #include <Stream.h>
 
 namespace Sonos {
 
-bool Discover::any(IPAddress *deviceIP, unsigned long timeoutMillis) {
-    bool deviceFound = false;
-    return UPnP::Discover::all(
-               [&deviceFound, deviceIP](IPAddress remoteIP, Stream &stream) -> bool {
-                   if (!stream.find("Sonos", 5)) {
-                       // this is not a Sonos response; wait for the next one
-                       return true;
-                   }
-                   if (deviceIP) {
-                       *deviceIP = remoteIP;
-                   }
-                   deviceFound = true;
-                   // device found, stop discovery
-                   return false;
-               },
-               "urn:schemas-upnp-org:device:ZonePlayer:1", 1) &&
-           deviceFound;
+static const char ZONE_PLAYER_ST[] = "urn:schemas-upnp-org:device:ZonePlayer:1";
+
+UPnP::PresenceListener presence(ZONE_PLAYER_ST);
+
+bool Discover::begin(unsigned long timeoutMillis) {
+    // a warm cache answers immediately, poll() then returns false right away
+    _discover.end();
+    _found = presence.cache().any(&_deviceIP, millis());
+    // the players spread their responses over MX seconds, which matters when many displays search at once
+    // within that window, the request is repeated once in case it or the responses got lost
+    return _found || _discover.begin(ZONE_PLAYER_ST, 2, timeoutMillis, 2);
+}
+
+bool Discover::poll() {
+    return _discover.poll([this](IPAddress remoteIP, Stream &stream) -> bool {
+        if (!presence.feed(remoteIP, stream)) {
+            // this is not a ZonePlayer response; wait for the next one
+            return true;
+        }
+        _deviceIP = remoteIP;
+        _found = true;
+        // device found, stop discovery
+        return false;
+    });
+}
+
+void Discover::end() {
+    _discover.end();
+}
+
+bool Discover::found(IPAddress *addr) const {
+    if (_found && addr) {
+        *addr = _deviceIP;
+    }
+    return _found;
+}
+
+const UPnP::Discover &Discover::search() const {
+    return _discover;
 }
 
 } // namespace Sonos
@@ -1,18 +1,42 @@
 #ifndef SONOS_DISCOVER_H_
 #define SONOS_DISCOVER_H_
 
-class IPAddress;
+#include <IPAddress.h>
+
+#include "../UPnP/Discover.h"
+#include "../UPnP/PresenceListener.h"
 
 namespace Sonos {
 
 class Discover {
   public:
-    // discover any Sonos device on the network via UPnP/SSDP
-    // returns true if a device responds within the timeout, false otherwise
-    // if addr is not NULL, the device's IP address is stored in *addr
-    static bool any(IPAddress *addr, unsigned long timeoutMillis = 5000);
+    // start a resumable search for any Sonos device on the network via UPnP/SSDP; it is advanced by poll()
+    // a device that announced itself recently is found right away, without a search
+    bool begin(unsigned long timeoutMillis = 5000);
+
+    // handle the responses received so far
+    // returns true while the search is running; afterwards, found() tells if a device responded
+    bool poll();
+
+    // stop the search early
+    void end();
+
+    // if a device has been found, its IP address is stored in *addr (if addr is not NULL)
+    bool found(IPAddress *addr = nullptr) const;
+
+    // statistics of the latest search, see UPnP::Discover
+    const UPnP::Discover &search() const;
+
+  private:
+    UPnP::Discover _discover;
+    bool _found = false;
+    IPAddress _deviceIP;
 };
 
+// announcements of the players, listened to while connected
+// also fed with the responses to searches, so only the first discovery has to wait for a search
+extern UPnP::PresenceListener presence;
+
 } // namespace Sonos
 
 #endif /* SONOS_DISCOVER_H_ */
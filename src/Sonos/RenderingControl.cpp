@@ -1,14 +1,19 @@
 #include "RenderingControl.h"
 
+#include <Arduino.h>
 #include <ESP8266HTTPClient.h>
 #include <HardwareSerial.h>
 #include <WString.h>
 #include <WiFiClient.h>
 #include <cstring>
+#include <memory>
 #include <pgmspace.h>
 #include <stddef.h>
 #include <stdlib.h>
 
+#include "../HTTP/BodyStream.h"
+#include "../HTTP/ConnectionPool.h"
+
 namespace Sonos {
 
 const char GET_VOLUME[] PROGMEM =
@@ -22,6 +27,37 @@ const char GET_VOLUME[] PROGMEM =
     "</s:Body>"
     "</s:Envelope>";
 
+const char GET_MUTE[] PROGMEM =
+    "<?xml version=\"1.0\"?>"
+    "<s:Envelope xmlns:s=\"http://schemas.xmlsoap.org/soap/envelope/\" s:encodingStyle=\"http://schemas.xmlsoap.org/soap/encoding/\">"
+    "<s:Body>"
+    "<u:GetMute xmlns:u=\"urn:schemas-upnp-org:service:RenderingControl:1\">"
+    "<InstanceID>%u</InstanceID>"
+    "<Channel>%s</Channel>"
+    "</u:GetMute>"
+    "</s:Body>"
+    "</s:Envelope>";
+
+const char CONTROL_REQUEST_HEAD[] PROGMEM = "POST /MediaRenderer/RenderingControl/Control HTTP/1.1\r\n"
+                                            "HOST: %s:1400\r\n"
+                                            "CONTENT-TYPE: text/xml; charset=\"utf-8\"\r\n"
+                                            "SOAPACTION: \"urn:schemas-upnp-org:service:RenderingControl:1#%s\"\r\n"
+                                            "CONTENT-LENGTH: %u\r\n"
+                                            "\r\n";
+
+static void appendControlRequest(String &requests, const String &host, const char *action, const char *body, uint32_t instanceID, const char *channel) {
+    size_t bodySize = strlen_P(body) + 1 + (3 * sizeof(instanceID) - 2) + (strlen(channel) - 2);
+    std::unique_ptr<char[]> bodyBuf(new char[bodySize]);
+    int bodyLength = snprintf_P(bodyBuf.get(), bodySize, body, instanceID, channel);
+
+    size_t headSize = sizeof(CONTROL_REQUEST_HEAD) + (host.length() - 2) + (strlen(action) - 2) + (3 * sizeof(bodyLength) - 2);
+    std::unique_ptr<char[]> headBuf(new char[headSize]);
+    snprintf_P(headBuf.get(), headSize, CONTROL_REQUEST_HEAD, host.c_str(), action, static_cast<unsigned>(bodyLength));
+
+    requests += headBuf.get();
+    requests += bodyBuf.get();
+}
+
 RenderingControl::RenderingControl(IPAddress deviceIP) : _deviceIP(deviceIP) {
 }
 
@@ -30,19 +66,19 @@ bool RenderingControl::GetVolume(GetVolumeCallback callback, uint32_t instanceID
     std::unique_ptr<char[]> buf(new char[size]);
     snprintf_P(buf.get(), size, GET_VOLUME, instanceID, channel);
 
-    WiFiClient wifiClient;
-    HTTPClient client;
-    client.begin(wifiClient, _deviceIP.toString(), 1400, F("/MediaRenderer/RenderingControl/Control"));
-    client.addHeader(F("SOAPACTION"), F("urn:schemas-upnp-org:service:RenderingControl:1#GetVolume"));
-    int status = client.POST(String(buf.get()));
+    HTTPClient *client = HTTP::connectionPool.acquire(_deviceIP, 1400, F("/MediaRenderer/RenderingControl/Control"));
+    if (!client) {
+        return false;
+    }
+    client->addHeader(F("SOAPACTION"), F("urn:schemas-upnp-org:service:RenderingControl:1#GetVolume"));
+    int status = client->POST(String(buf.get()));
 
     bool result = false;
 
     Serial.print(F("GetVolume returned HTTP status "));
     Serial.println(status);
+    HTTP::BodyStream stream(client->getStream(), client->getSize());
     if (status == 200) {
-        WiFiClient &stream = client.getStream();
-
         if (stream.find("<CurrentVolume>")) {
             // TODO read only until next '<' and check format
             long volume = stream.parseInt();
@@ -56,9 +92,173 @@ bool RenderingControl::GetVolume(GetVolumeCallback callback, uint32_t instanceID
         }
     }
 
-    client.end();
+    // the connection can only be reused if the rest of the response has been consumed
+    HTTP::connectionPool.release(client, status > 0 && stream.drain());
 
     return result;
 }
 
+bool RenderingControl::beginGetVolumeState(uint32_t instanceID, unsigned long timeoutMillis) {
+    end();
+
+    // HTTPClient waits for each response before sending the next request, so the requests are written directly
+    String host = _deviceIP.toString();
+    String requests;
+    appendControlRequest(requests, host, "GetVolume", GET_VOLUME, instanceID, "Master");
+    appendControlRequest(requests, host, "GetVolume", GET_VOLUME, instanceID, "LF");
+    appendControlRequest(requests, host, "GetVolume", GET_VOLUME, instanceID, "RF");
+    appendControlRequest(requests, host, "GetMute", GET_MUTE, instanceID, "Master");
+
+    _client.setTimeout(_CONNECT_TIMEOUT_MILLIS);
+    if (!_client.connect(_deviceIP, 1400)) {
+        Serial.println(F("GetVolumeState failed to connect"));
+        return false;
+    }
+    _client.setNoDelay(true);
+    if (_client.write(requests.c_str(), requests.length()) != requests.length()) {
+        Serial.println(F("GetVolumeState failed to send the requests"));
+        _client.stop();
+        return false;
+    }
+
+    _state = _S_STATUS_LINE;
+    _startMillis = millis();
+    _timeoutMillis = timeoutMillis;
+    _response = 0;
+    _volumeState = VolumeState();
+    _lineLength = 0;
+    _bodyRemaining = -1;
+    return true;
+}
+
+RenderingControl::Result RenderingControl::poll() {
+    if (_state == _S_IDLE) {
+        return FAILED;
+    }
+    if (millis() - _startMillis >= _timeoutMillis) {
+        return _fail(F("GetVolumeState timed out"));
+    }
+
+    // the responses arrive in the order of the requests
+    for (size_t processed = 0; processed < _BYTES_PER_CALL && _client.available() > 0; processed++) {
+        int ch = _client.read();
+        if (ch < 0) {
+            break;
+        }
+
+        if (_state == _S_BODY) {
+            _processBody(static_cast<char>(ch));
+            if (--_bodyRemaining > 0) {
+                continue;
+            }
+            if (!_endResponse()) {
+                return _fail(F("GetVolumeState returned an unexpected response"));
+            }
+            if (++_response == 4) {
+                end();
+                return DONE;
+            }
+            _state = _S_STATUS_LINE;
+            continue;
+        }
+
+        if (ch != '\n') {
+            if (ch != '\r' && _lineLength < _LINE_SIZE - 1) {
+                _line[_lineLength++] = static_cast<char>(ch);
+            }
+            continue;
+        }
+        _line[_lineLength] = '\0';
+        _lineLength = 0;
+        if (!_processLine()) {
+            return FAILED;
+        }
+    }
+
+    if (!_client.connected() && !_client.available()) {
+        return _fail(F("GetVolumeState lost the connection"));
+    }
+    return PENDING;
+}
+
+const VolumeState &RenderingControl::volumeState() const {
+    return _volumeState;
+}
+
+void RenderingControl::end() {
+    _client.stop();
+    _state = _S_IDLE;
+}
+
+bool RenderingControl::_processLine() {
+    if (_state == _S_STATUS_LINE) {
+        if (strncmp_P(_line, PSTR("HTTP/1.1 200 "), 13) != 0) {
+            Serial.print(F("GetVolumeState returned \""));
+            Serial.print(_line);
+            Serial.println('"');
+            _fail(nullptr);
+            return false;
+        }
+        // only the length is needed to find the start of the next response
+        _bodyRemaining = -1;
+        _state = _S_HEADERS;
+        return true;
+    }
+
+    if (_line[0]) {
+        const char *separator = strchr(_line, ':');
+        if (separator && separator - _line == 14 && strncasecmp_P(_line, PSTR("Content-Length"), 14) == 0) {
+            _bodyRemaining = atoi(separator + 1);
+        }
+        return true;
+    }
+
+    if (_bodyRemaining <= 0) {
+        _fail(F("GetVolumeState returned a response without Content-Length"));
+        return false;
+    }
+    _tagMatched = 0;
+    _value = -1;
+    _valueComplete = false;
+    _state = _S_BODY;
+    return true;
+}
+
+void RenderingControl::_processBody(char ch) {
+    const char *tag = _response < 3 ? "<CurrentVolume>" : "<CurrentMute>";
+    size_t tagLength = strlen(tag);
+
+    if (_tagMatched < tagLength) {
+        // the tags start with their only '<', so a mismatch can only restart the match at the current character
+        _tagMatched = ch == tag[_tagMatched] ? _tagMatched + 1 : ch == tag[0] ? 1 : 0;
+    } else if (!_valueComplete) {
+        if (ch >= '0' && ch <= '9' && _value < 1000) {
+            _value = (_value < 0 ? 0 : _value * 10) + (ch - '0');
+        } else {
+            // anything but digits followed by the closing tag is rejected by _endResponse()
+            _valueComplete = true;
+            if (ch != '<') {
+                _value = -1;
+            }
+        }
+    }
+}
+
+bool RenderingControl::_endResponse() {
+    if (!_valueComplete || _value < 0 || _value > 100) {
+        return false;
+    }
+    int8_t *fields[] = {&_volumeState.master, &_volumeState.lf, &_volumeState.rf, &_volumeState.mute};
+    *fields[_response] = static_cast<int8_t>(_value);
+    return true;
+}
+
+RenderingControl::Result RenderingControl::_fail(const __FlashStringHelper *message) {
+    if (message) {
+        Serial.println(message);
+    }
+    end();
+    return FAILED;
+}
+
 } // namespace Sonos
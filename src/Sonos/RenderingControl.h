@@ -2,8 +2,14 @@
 #define SONOS_RENDERINGCONTROL_H_
 
 #include <IPAddress.h>
+#include <Stream.h>
+#include <WString.h>
+#include <WiFiClient.h>
 #include <cstdint>
 #include <functional>
+#include <stddef.h>
+
+#include "RenderingControlEvent.h"
 
 namespace Sonos {
 
@@ -11,12 +17,68 @@ class RenderingControl {
   public:
     typedef std::function<void(uint16_t volume)> GetVolumeCallback;
 
+    enum Result {
+        // the responses are still being parsed, poll again
+        PENDING,
+        // all responses have been parsed
+        DONE,
+        // a request failed, a response was unexpected, or the timeout elapsed
+        FAILED,
+    };
+
     explicit RenderingControl(IPAddress deviceIP);
 
     bool GetVolume(GetVolumeCallback callback, uint32_t instanceID = 0, const char *channel = "Master");
 
+    // resumable snapshot of the master, LF and RF volume and the mute state, e.g. to show before the initial event arrives
+    // the four requests are sent back-to-back over a dedicated connection, which is closed once the last response is in
+    // only connecting is blocking (for a second at most); the responses are parsed by poll() as they arrive
+    bool beginGetVolumeState(uint32_t instanceID = 0, unsigned long timeoutMillis = 2000);
+
+    // advance the pending snapshot
+    Result poll();
+
+    // after poll() returned DONE, the complete snapshot
+    const VolumeState &volumeState() const;
+
+    // abort a pending snapshot
+    void end();
+
   private:
+    enum _State {
+        _S_IDLE,
+        _S_STATUS_LINE,
+        _S_HEADERS,
+        _S_BODY,
+    };
+
+    static const unsigned long _CONNECT_TIMEOUT_MILLIS = 1000;
+    // response bytes processed per call, bounding the time spent in poll()
+    static const size_t _BYTES_PER_CALL = 512;
+    // only the status line and Content-Length are of interest, longer header lines are cut off
+    static const size_t _LINE_SIZE = 64;
+
     IPAddress _deviceIP;
+
+    // state of a pending snapshot
+    WiFiClient _client;
+    _State _state = _S_IDLE;
+    unsigned long _startMillis;
+    unsigned long _timeoutMillis;
+    uint8_t _response;
+    VolumeState _volumeState;
+    char _line[_LINE_SIZE];
+    size_t _lineLength;
+    int _bodyRemaining;
+    // progress matching the tag of the current response, and the value behind it (-1 until a digit has been seen)
+    size_t _tagMatched;
+    int _value;
+    bool _valueComplete;
+
+    bool _processLine();
+    void _processBody(char ch);
+    bool _endResponse();
+    Result _fail(const __FlashStringHelper *message);
 };
 
 } // namespace Sonos
@@ -0,0 +1,89 @@
+#include "RenderingControlEvent.h"
+
+#include <HardwareSerial.h>
+#include <cctype>
+#include <cstring>
+
+namespace Sonos {
+
+bool renderingControlEventXmlTagCallback(const XML::Tag &tag, VolumeState &volumeState) {
+    if (!strcmp(tag.name(), "Volume")) {
+        const char *channel;
+        if (!XML::extractAttributeValue(tag, "channel", &channel)) {
+            Serial.println(F("Failed to extract channel attribute from tag"));
+            return false;
+        };
+
+        const char *val;
+        if (!XML::extractAttributeValue(tag, "val", &val)) {
+            Serial.println(F("Failed to extract val attribute from tag"));
+            return false;
+        };
+
+        uint16_t volume = 0;
+        for (const char *p = val; *p; p++) {
+            if (isdigit(*p)) {
+                volume = 10 * volume + (*p - '0');
+            } else {
+                Serial.println(F("Found a non-digit in val"));
+                return false;
+            }
+            if (volume > 100) {
+                Serial.println(F("Too large val"));
+                return false;
+            }
+        }
+
+        if (!strcmp(channel, "Master")) {
+            volumeState.master = volume;
+        } else if (!strcmp(channel, "LF")) {
+            volumeState.lf = volume;
+        } else if (!strcmp(channel, "RF")) {
+            volumeState.rf = volume;
+        }
+    } else if (!strcmp(tag.name(), "Mute")) {
+        const char *channel;
+        if (!XML::extractAttributeValue(tag, "channel", &channel)) {
+            Serial.println(F("Failed to extract channel attribute from tag"));
+            return false;
+        };
+
+        if (strcmp(channel, "Master")) {
+            /* only Master channel is muted */
+            return true;
+        }
+
+        const char *val;
+        if (!XML::extractAttributeValue(tag, "val", &val)) {
+            Serial.println(F("Failed to extract val attribute from tag"));
+            return false;
+        };
+
+        if (!strcmp(val, "0")) {
+            volumeState.mute = 0;
+        } else if (!strcmp(val, "1")) {
+            volumeState.mute = 1;
+        } else {
+            Serial.println(F("Invalid boolean val"));
+            return false;
+        }
+    }
+
+    return true;
+}
+
+bool parseRenderingControlEvent(Stream &stream, VolumeState &volumeState) {
+    char tagBuffer[RenderingControlEventParser::TAG_BUFFER_SIZE];
+    return XML::extractEncodedTags<VolumeState &>(stream, "</LastChange>", tagBuffer, sizeof(tagBuffer), &renderingControlEventXmlTagCallback, volumeState);
+}
+
+RenderingControlEventParser::RenderingControlEventParser(VolumeState &volumeState)
+    : _tokenizer(_tagBuffer, sizeof(_tagBuffer), "</LastChange>"),
+      _tagCallback([&volumeState](const XML::Tag &tag) -> bool { return renderingControlEventXmlTagCallback(tag, volumeState); }) {
+}
+
+XML::EncodedTagTokenizer::Result RenderingControlEventParser::parseAvailable(Stream &stream) {
+    return XML::feedAvailableEncodedTags(stream, _tokenizer, _tagCallback);
+}
+
+} // namespace Sonos
@@ -0,0 +1,53 @@
+#ifndef SONOS_RENDERINGCONTROLEVENT_H_
+#define SONOS_RENDERINGCONTROLEVENT_H_
+
+#include <Stream.h>
+#include <cstdint>
+#include <stddef.h>
+
+#include "../XML/Utilities.h"
+
+namespace Sonos {
+
+struct VolumeState {
+    int8_t master = -1, lf = -1, rf = -1, mute = -1;
+
+    bool isComplete() const {
+        return master != -1 && lf != -1 && rf != -1 && mute != -1;
+    }
+
+    bool operator!=(const VolumeState &other) const {
+        return master != other.master || lf != other.lf || rf != other.rf || mute != other.mute;
+    }
+};
+
+// update volumeState from a single tag of the LastChange state variable
+bool renderingControlEventXmlTagCallback(const XML::Tag &tag, VolumeState &volumeState);
+
+// update volumeState from the body of a RenderingControl NOTIFY request
+// fields that are not part of the event keep their previous values
+bool parseRenderingControlEvent(Stream &stream, VolumeState &volumeState);
+
+// resumable variant of parseRenderingControlEvent(), for bodies that arrive a slice at a time
+class RenderingControlEventParser {
+  public:
+    // the LastChange tags are short, the buffer only has to hold the longest one we are interested in
+    static const size_t TAG_BUFFER_SIZE = 128;
+
+    explicit RenderingControlEventParser(VolumeState &volumeState);
+
+    RenderingControlEventParser(const RenderingControlEventParser &) = delete;
+    RenderingControlEventParser &operator=(const RenderingControlEventParser &) = delete;
+
+    // parse the data that is already available in the stream, without waiting for more
+    XML::EncodedTagTokenizer::Result parseAvailable(Stream &stream);
+
+  private:
+    char _tagBuffer[TAG_BUFFER_SIZE];
+    XML::EncodedTagTokenizer _tokenizer;
+    XML::TagCallback _tagCallback;
+};
+
+} // namespace Sonos
+
+#endif /* SONOS_RENDERINGCONTROLEVENT_H_ */
@@ -0,0 +1,196 @@
+#include "RoomDirectory.h"
+
+#include <Arduino.h>
+#include <HardwareSerial.h>
+#include <utility>
+
+#include "../Util/CRC32.h"
+
+namespace Sonos {
+
+static bool sameRoom(const ZoneInfo &a, const ZoneInfo &b) {
+    return a.uuid == b.uuid && a.name == b.name && a.playerIP == b.playerIP;
+}
+
+static bool sameRooms(const std::vector<ZoneInfo> &a, const std::vector<ZoneInfo> &b) {
+    if (a.size() != b.size()) {
+        return false;
+    }
+    for (size_t i = 0; i < a.size(); i++) {
+        if (!sameRoom(a[i], b[i])) {
+            return false;
+        }
+    }
+    return true;
+}
+
+RoomDirectory::Update::Update(RoomDirectory &directory) : _directory(directory), _version(directory._version) {
+}
+
+void RoomDirectory::Update::add(const ZoneInfo &room) {
+    // the rooms compared so far may have been replaced in the meantime
+    if (_stale || _directory._version != _version) {
+        _stale = true;
+        return;
+    }
+    if (!_changed && _count < _directory._rooms.size() && sameRoom(room, _directory._rooms[_count])) {
+        _count++;
+        return;
+    }
+    if (!_changed) {
+        _changed = true;
+        _rooms.assign(_directory._rooms.begin(), _directory._rooms.begin() + _count);
+    }
+    _rooms.push_back(room);
+    _count++;
+}
+
+void RoomDirectory::Update::commit() {
+    if (_stale || _directory._version != _version) {
+        Serial.println(F("Room directory refreshed during update, keeping it"));
+        return;
+    }
+    if (_changed) {
+        _directory._rooms = std::move(_rooms);
+        _directory._version++;
+    } else if (_count != _directory._rooms.size() || !_directory._valid) {
+        // fewer rooms than before, all of them unchanged
+        _directory._rooms.erase(_directory._rooms.begin() + _count, _directory._rooms.end());
+        _directory._version++;
+    }
+    _directory._updated();
+}
+
+RoomDirectory::RoomDirectory(unsigned long ttlMillis) : _ttlMillis(ttlMillis) {
+}
+
+void RoomDirectory::setDeviceIP(const IPAddress &deviceIP) {
+    _deviceIP = deviceIP;
+}
+
+void RoomDirectory::update(std::vector<ZoneInfo> &&rooms) {
+    if (!_valid || !sameRooms(rooms, _rooms)) {
+        _rooms = std::move(rooms);
+        _version++;
+    }
+    _updated();
+}
+
+void RoomDirectory::handle() {
+    switch (_state) {
+    case _S_IDLE:
+        if (_attempted && (!_refreshRequested || millis() - _attemptMillis < _RETRY_MILLIS)) {
+            break;
+        }
+        _attempted = true;
+        _refreshRequested = false;
+        _attemptMillis = millis();
+        if (_deviceIP.isSet()) {
+            _beginFetch();
+        } else if (_discover.begin()) {
+            _state = _S_DISCOVERING;
+        } else {
+            _fail(NO_DEVICES_FOUND);
+        }
+        break;
+    case _S_DISCOVERING:
+        if (!_discover.poll()) {
+            if (_discover.found(&_deviceIP)) {
+                _beginFetch();
+            } else {
+                _fail(NO_DEVICES_FOUND);
+            }
+        }
+        break;
+    case _S_FETCHING:
+        switch (_topology->poll()) {
+        case ZoneGroupTopology::PENDING:
+            break;
+        case ZoneGroupTopology::DONE:
+            _topology.reset();
+            update(std::move(_pendingRooms));
+            _pendingRooms.clear();
+            _state = _S_IDLE;
+            break;
+        case ZoneGroupTopology::FAILED:
+            _fail(DECODING_FAILED);
+            break;
+        }
+        break;
+    }
+}
+
+void RoomDirectory::requestRefresh() {
+    _refreshRequested = true;
+}
+
+bool RoomDirectory::valid() const {
+    return _valid;
+}
+
+bool RoomDirectory::fresh() const {
+    return _valid && ageMillis() < _ttlMillis;
+}
+
+unsigned long RoomDirectory::ageMillis() const {
+    return millis() - _updatedMillis;
+}
+
+uint32_t RoomDirectory::checksum() const {
+    return _checksum;
+}
+
+RoomDirectory::Error RoomDirectory::error() const {
+    return _error;
+}
+
+const std::vector<ZoneInfo> &RoomDirectory::rooms() const {
+    return _rooms;
+}
+
+bool RoomDirectory::find(const char *uuid, IPAddress *playerIP) const {
+    for (const ZoneInfo &room : _rooms) {
+        if (room.uuid == uuid) {
+            *playerIP = room.playerIP;
+            return true;
+        }
+    }
+    return false;
+}
+
+void RoomDirectory::_beginFetch() {
+    _pendingRooms.clear();
+    _topology.reset(new ZoneGroupTopology(_deviceIP));
+    if (_topology->beginGetZoneGroupState_Decoded([this](const ZoneInfo &info) { _pendingRooms.push_back(info); })) {
+        _state = _S_FETCHING;
+    } else {
+        _fail(DECODING_FAILED);
+    }
+}
+
+void RoomDirectory::_updated() {
+    // the terminating nul separates the fields
+    Util::CRC32 crc;
+    for (const ZoneInfo &room : _rooms) {
+        uint8_t ip[4] = {room.playerIP[0], room.playerIP[1], room.playerIP[2], room.playerIP[3]};
+        crc.update(room.uuid.c_str(), room.uuid.length() + 1).update(room.name.c_str(), room.name.length() + 1).update(ip, sizeof(ip));
+    }
+    _checksum = crc.value();
+
+    _valid = true;
+    _updatedMillis = millis();
+    _error = NONE;
+}
+
+void RoomDirectory::_fail(Error error) {
+    Serial.println(F("Failed to refresh the room directory"));
+    _topology.reset();
+    _pendingRooms.clear();
+    // the device might be gone, so the next refresh starts with a discovery that doesn't return it again
+    presence.cache().remove(_deviceIP);
+    _deviceIP = IPAddress();
+    _error = error;
+    _state = _S_IDLE;
+}
+
+} // namespace Sonos
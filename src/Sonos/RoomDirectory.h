@@ -0,0 +1,114 @@
+#ifndef SONOS_ROOMDIRECTORY_H_
+#define SONOS_ROOMDIRECTORY_H_
+
+#include <IPAddress.h>
+#include <cstdint>
+#include <memory>
+#include <vector>
+
+#include "Discover.h"
+#include "ZoneGroupState.h"
+#include "ZoneGroupTopology.h"
+
+namespace Sonos {
+
+// cached list of the visible players in the household
+// filled a slice at a time from the main loop and kept up to date by topology events, so lookups never block
+class RoomDirectory {
+  public:
+    enum Error {
+        NONE,
+        NO_DEVICES_FOUND,
+        DECODING_FAILED,
+    };
+
+    // replaces the rooms a room at a time, e.g. while a topology event is parsed
+    // as long as the rooms match the current ones, nothing is copied, and the version only changes if a room differs
+    class Update {
+      public:
+        explicit Update(RoomDirectory &directory);
+
+        void add(const ZoneInfo &room);
+
+        // replace the rooms with those added
+        // nothing changes if the directory has been refreshed since the update began, which is at least as recent
+        void commit();
+
+      private:
+        RoomDirectory &_directory;
+        uint32_t _version;
+        bool _stale = false;
+        // rooms added so far; they are only copied once they differ from the current rooms
+        size_t _count = 0;
+        bool _changed = false;
+        std::vector<ZoneInfo> _rooms;
+    };
+
+    explicit RoomDirectory(unsigned long ttlMillis = 60000);
+
+    // device to ask for the zone group state; without one, a refresh starts with a discovery
+    void setDeviceIP(const IPAddress &deviceIP);
+
+    // replace the rooms, e.g. with those from a topology event
+    void update(std::vector<ZoneInfo> &&rooms);
+
+    // advance a pending refresh; the directory is filled once, and afterwards only refreshed on request
+    void handle();
+
+    // refresh as soon as possible (but not more often than every few seconds)
+    void requestRefresh();
+
+    // whether the rooms have been filled at least once
+    bool valid() const;
+
+    // whether the rooms are younger than the TTL
+    bool fresh() const;
+
+    unsigned long ageMillis() const;
+
+    // CRC-32 of the rooms' UUIDs, names and IP addresses, so it can be used as an entity tag across reboots
+    uint32_t checksum() const;
+
+    // error of the latest refresh
+    Error error() const;
+
+    const std::vector<ZoneInfo> &rooms() const;
+
+    // if the directory knows the player with the given UUID, store its IP address in *playerIP
+    bool find(const char *uuid, IPAddress *playerIP) const;
+
+  private:
+    enum _State {
+        _S_IDLE,
+        _S_DISCOVERING,
+        _S_FETCHING,
+    };
+
+    // minimum time between two refresh attempts
+    static const unsigned long _RETRY_MILLIS = 5000;
+
+    unsigned long _ttlMillis;
+    std::vector<ZoneInfo> _rooms;
+    bool _valid = false;
+    unsigned long _updatedMillis = 0;
+    uint32_t _version = 0;
+    uint32_t _checksum = 0;
+    Error _error = NONE;
+
+    _State _state = _S_IDLE;
+    bool _attempted = false;
+    bool _refreshRequested = false;
+    unsigned long _attemptMillis = 0;
+    IPAddress _deviceIP;
+    Discover _discover;
+    std::unique_ptr<ZoneGroupTopology> _topology;
+    std::vector<ZoneInfo> _pendingRooms;
+
+    void _beginFetch();
+    void _fail(Error error);
+    void _updated();
+};
+
+} // namespace Sonos
+
+#endif /* SONOS_ROOMDIRECTORY_H_ */
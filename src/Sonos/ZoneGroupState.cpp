@@ -0,0 +1,138 @@
+#include "ZoneGroupState.h"
+
+#include <HardwareSerial.h>
+#include <cstring>
+
+namespace Sonos {
+
+static const char *const MEMBER_TAGS[] = {"ZoneGroupMember", "Satellite", nullptr};
+static const char *const MEMBER_ATTRIBUTES[] = {"UUID", "ZoneName", "Location", "Invisible", nullptr};
+static const char *const LOOKUP_ATTRIBUTES[] = {"UUID", "Location", "Invisible", nullptr};
+
+// extract the player IP from a Location URL like "http://192.168.1.2:1400/xml/device_description.xml"
+static bool parsePlayerIP(const char *location, IPAddress *playerIP) {
+    const char *playerIPStart = strstr(location, "//");
+    if (!playerIPStart) {
+        Serial.println(F("Failed to find start of player IP in Location"));
+        return false;
+    }
+    playerIPStart += 2;
+    const char *playerIPEnd = strchr(playerIPStart, ':');
+    if (!playerIPEnd) {
+        Serial.println(F("Failed to find end of player IP in Location"));
+        return false;
+    }
+    char playerIPString[16];
+    size_t length = playerIPEnd - playerIPStart;
+    if (length >= sizeof(playerIPString)) {
+        Serial.println(F("Player IP in Location is too long"));
+        return false;
+    }
+    memcpy(playerIPString, playerIPStart, length);
+    playerIPString[length] = '\0';
+    if (!playerIP->fromString(playerIPString)) {
+        Serial.println(F("Failed to parse player IP"));
+        return false;
+    }
+    return true;
+}
+
+bool parseZoneGroupState(Stream &stream, ZoneInfoCallback callback, bool visibleOnly) {
+    ZoneGroupStateParser parser(callback, visibleOnly);
+    return parser.parse(stream);
+}
+
+// the state is an XML-encoded XML string wrapped in a <ZoneGroupState> tag and some SOAP
+// member tags carry a few dozen attributes, but only the few in use are decoded into the buffer
+ZoneGroupStateParser::ZoneGroupStateParser(ZoneInfoCallback callback, bool visibleOnly)
+    : _callback(callback), _visibleOnly(visibleOnly), _tokenizer(_tagBuffer, sizeof(_tagBuffer), "</ZoneGroupState>"),
+      _tagCallback([this](const XML::Tag &tag) -> bool { return _handleTag(tag); }) {
+    _tokenizer.setFilter(MEMBER_TAGS, MEMBER_ATTRIBUTES);
+}
+
+ZoneGroupStateParser::ZoneGroupStateParser(const char *uuid, IPAddress *playerIP, bool visibleOnly)
+    : _uuid(uuid), _playerIP(playerIP), _visibleOnly(visibleOnly), _tokenizer(_tagBuffer, sizeof(_tagBuffer), "</ZoneGroupState>"),
+      _tagCallback([this](const XML::Tag &tag) -> bool { return _handleLookupTag(tag); }) {
+    _tokenizer.setFilter(MEMBER_TAGS, LOOKUP_ATTRIBUTES);
+}
+
+bool ZoneGroupStateParser::parse(Stream &stream) {
+    bool result = XML::extractEncodedTags(stream, _tokenizer, _tagCallback);
+    return result || _found;
+}
+
+XML::EncodedTagTokenizer::Result ZoneGroupStateParser::parseAvailable(Stream &stream) {
+    XML::EncodedTagTokenizer::Result result = XML::feedAvailableEncodedTags(stream, _tokenizer, _tagCallback);
+    return _found ? XML::EncodedTagTokenizer::DONE : result;
+}
+
+bool ZoneGroupStateParser::found() const {
+    return _found;
+}
+
+bool ZoneGroupStateParser::_handleTag(const XML::Tag &tag) {
+    ZoneInfo info;
+    const char *invisible = tag.attribute("Invisible");
+    info.visible = !invisible || strcmp(invisible, "1");
+    if (!info.visible && _visibleOnly) {
+        /* continue tag extraction */
+        return true;
+    }
+
+    const char *uuid;
+    if (!XML::extractAttributeValue(tag, "UUID", &uuid)) {
+        Serial.println(F("Failed to extract UUID attribute from tag"));
+        return false;
+    }
+    info.uuid = uuid;
+
+    const char *name;
+    if (!XML::extractAttributeValue(tag, "ZoneName", &name)) {
+        Serial.println(F("Failed to extract ZoneName attribute from tag"));
+        return false;
+    }
+    info.name = name;
+
+    const char *location;
+    if (!XML::extractAttributeValue(tag, "Location", &location)) {
+        Serial.println(F("Failed to extract Location attribute from tag"));
+        return false;
+    }
+    if (!parsePlayerIP(location, &info.playerIP)) {
+        return false;
+    }
+
+    _callback(info);
+
+    return true;
+}
+
+bool ZoneGroupStateParser::_handleLookupTag(const XML::Tag &tag) {
+    const char *uuid = tag.attribute("UUID");
+    if (!uuid || strcmp(uuid, _uuid)) {
+        /* continue tag extraction */
+        return true;
+    }
+
+    const char *invisible = tag.attribute("Invisible");
+    if (_visibleOnly && invisible && !strcmp(invisible, "1")) {
+        /* continue tag extraction */
+        return true;
+    }
+
+    const char *location;
+    if (!XML::extractAttributeValue(tag, "Location", &location)) {
+        Serial.println(F("Failed to extract Location attribute from tag"));
+        return false;
+    }
+    if (!parsePlayerIP(location, _playerIP)) {
+        return false;
+    }
+
+    _found = true;
+
+    /* player found, stop tag extraction */
+    return false;
+}
+
+} // namespace Sonos
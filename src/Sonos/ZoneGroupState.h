@@ -0,0 +1,70 @@
+#ifndef SONOS_ZONEGROUPSTATE_H_
+#define SONOS_ZONEGROUPSTATE_H_
+
+#include <Arduino.h>
+#include <IPAddress.h>
+#include <Stream.h>
+#include <WString.h>
+#include <functional>
+#include <stddef.h>
+
+#include "../XML/Utilities.h"
+
+namespace Sonos {
+
+struct ZoneInfo {
+    String uuid;
+    String name;
+    IPAddress playerIP;
+    boolean visible;
+};
+
+typedef std::function<void(const ZoneInfo &info)> ZoneInfoCallback;
+
+// parse the ZoneGroupState state variable from the stream, up to the closing </ZoneGroupState>
+// for every (visible) player, the callback is invoked
+bool parseZoneGroupState(Stream &stream, ZoneInfoCallback callback, bool visibleOnly = true);
+
+// resumable variant of parseZoneGroupState(), for responses that are consumed a slice at a time
+class ZoneGroupStateParser {
+  public:
+    explicit ZoneGroupStateParser(ZoneInfoCallback callback, bool visibleOnly = true);
+
+    // look up a single player by UUID, storing its IP address in *playerIP
+    // attributes are compared as they are decoded, no ZoneInfo is created, and parsing stops as soon as the player is found
+    ZoneGroupStateParser(const char *uuid, IPAddress *playerIP, bool visibleOnly = true);
+
+    ZoneGroupStateParser(const ZoneGroupStateParser &) = delete;
+    ZoneGroupStateParser &operator=(const ZoneGroupStateParser &) = delete;
+
+    // parse the rest of the state from the stream, waiting for data as needed
+    // a lookup succeeds as soon as the player has been found
+    bool parse(Stream &stream);
+
+    // parse the data that is already available in the stream, without waiting for more
+    // a lookup is DONE as soon as the player has been found
+    XML::EncodedTagTokenizer::Result parseAvailable(Stream &stream);
+
+    // whether a lookup has found the player
+    bool found() const;
+
+  private:
+    // only the attributes in use are kept, so the buffer only has to hold these
+    static const size_t _TAG_BUFFER_SIZE = 256;
+
+    ZoneInfoCallback _callback;
+    const char *_uuid = nullptr;
+    IPAddress *_playerIP = nullptr;
+    bool _found = false;
+    bool _visibleOnly;
+    char _tagBuffer[_TAG_BUFFER_SIZE];
+    XML::EncodedTagTokenizer _tokenizer;
+    XML::TagCallback _tagCallback;
+
+    bool _handleTag(const XML::Tag &tag);
+    bool _handleLookupTag(const XML::Tag &tag);
+};
+
+} // namespace Sonos
+
+#endif /* SONOS_ZONEGROUPSTATE_H_ */
@@ -1,11 +1,13 @@
 #include "ZoneGroupTopology.h"
 
+#include <Arduino.h>
 #include <ESP8266HTTPClient.h>
 #include <HardwareSerial.h>
-#include <WiFiClient.h>
+#include <memory>
 #include <pgmspace.h>
+#include <utility>
 
-#include "../XML/Utilities.h"
+#include "../HTTP/ConnectionPool.h"
 
 namespace Sonos {
 
@@ -21,77 +23,102 @@ const char GET_ZONE_GROUP_STATE[] PROGMEM =
 ZoneGroupTopology::ZoneGroupTopology(IPAddress deviceIP) : _deviceIP(deviceIP) {
 }
 
-bool ZoneGroupTopology::GetZoneGroupState_Decoded(ZoneInfoCallback callback, bool visibleOnly) {
-    bool result = false;
-
-    WiFiClient wifiClient;
-    HTTPClient client;
-
-    if (client.begin(wifiClient, _deviceIP.toString(), 1400, F("/ZoneGroupTopology/Control"))) {
-        client.addHeader(F("SOAPACTION"), F("urn:schemas-upnp-org:service:ZoneGroupTopology:1#GetZoneGroupState"));
-        int status = client.POST(FPSTR(GET_ZONE_GROUP_STATE));
-
-        Serial.print(F("GetZoneGroupState returned HTTP status "));
-        Serial.println(status);
-        if (status == 200) {
-
-            // the response is an XML-encoded XML string wrapped in a <ZoneGroupState> tag and some SOAP
-            // extract the encoded tags by matching &lt; and &gt;
-
-            result = XML::extractEncodedTags(client.getStream(), "</ZoneGroupState>", [callback, visibleOnly](String tag) -> bool {
-                if (!tag.startsWith(F("<Satellite ")) && !tag.startsWith(F("<ZoneGroupMember "))) {
-                    /* continue tag extraction */
-                    return true;
-                }
-
-                ZoneInfo info;
-                info.visible = tag.indexOf(F(" Invisible=\"1\"")) < 0;
-                if (!info.visible && visibleOnly) {
-                    /* continue tag extraction */
-                    return true;
-                }
-
-                if (!XML::extractAttributeValue(tag, F("UUID"), &info.uuid)) {
-                    Serial.println(F("Failed to extract UUID attribute from tag"));
-                    return false;
-                }
-
-                if (!XML::extractAttributeValue(tag, F("ZoneName"), &info.name)) {
-                    Serial.println(F("Failed to extract ZoneName attribute from tag"));
-                    return false;
-                }
-
-                String location;
-                if (!XML::extractAttributeValue(tag, F("Location"), &location)) {
-                    Serial.println(F("Failed to extract Location attribute from tag"));
-                    return false;
-                }
-                int playerIPStart = location.indexOf(F("//"));
-                if (playerIPStart < 0) {
-                    Serial.println(F("Failed to find start of player IP in Location"));
-                    return false;
-                }
-                playerIPStart += 2;
-                int playerIPEnd = location.indexOf(':', playerIPStart);
-                if (playerIPEnd < 0) {
-                    Serial.println(F("Failed to find end of player IP in Location"));
-                    return false;
-                }
-                if (!info.playerIP.fromString(location.substring(playerIPStart, playerIPEnd))) {
-                    Serial.println(F("Failed to parse player IP"));
-                    return false;
-                }
-
-                callback(info);
-
-                return true;
-            });
-        }
-
-        client.end();
+ZoneGroupTopology::~ZoneGroupTopology() {
+    end();
+}
+
+bool ZoneGroupTopology::beginGetZoneGroupState_Decoded(ZoneInfoCallback callback, bool visibleOnly, unsigned long timeoutMillis) {
+    return _begin(new ZoneGroupStateParser(callback, visibleOnly), timeoutMillis);
+}
+
+bool ZoneGroupTopology::beginFindPlayer(const char *uuid, IPAddress *playerIP, unsigned long timeoutMillis) {
+    return _begin(new ZoneGroupStateParser(uuid, playerIP), timeoutMillis);
+}
+
+ZoneGroupTopology::Result ZoneGroupTopology::poll() {
+    if (!_client) {
+        return FAILED;
+    }
+
+    switch (_parser->parseAvailable(*_body)) {
+    case XML::EncodedTagTokenizer::DONE:
+        // a lookup stops as soon as the player has been found, reading the rest of the state isn't worth it
+        _found = _parser->found();
+        _release(!_found);
+        return DONE;
+    case XML::EncodedTagTokenizer::ABORTED:
+        Serial.println(F("Callback returned false"));
+        _release(false);
+        return FAILED;
+    case XML::EncodedTagTokenizer::MORE:
+        break;
+    }
+
+    if (!_body->available() && (!_body->remaining() || !_client->connected())) {
+        Serial.println(F("Stream ended unexpectedly"));
+        _release(false);
+        return FAILED;
+    }
+    if (millis() - _startMillis >= _timeoutMillis) {
+        Serial.println(F("GetZoneGroupState timed out"));
+        _release(false);
+        return FAILED;
+    }
+    return PENDING;
+}
+
+bool ZoneGroupTopology::found() const {
+    return _found;
+}
+
+void ZoneGroupTopology::end() {
+    if (_client) {
+        _release(false);
+    }
+}
+
+bool ZoneGroupTopology::_begin(ZoneGroupStateParser *parser, unsigned long timeoutMillis) {
+    std::unique_ptr<ZoneGroupStateParser> newParser(parser);
+
+    end();
+    _found = false;
+
+    _client = _sendGetZoneGroupState();
+    if (!_client) {
+        return false;
     }
+    _body.reset(new HTTP::BodyStream(_client->getStream(), _client->getSize()));
+    _parser = std::move(newParser);
+    _startMillis = millis();
+    _timeoutMillis = timeoutMillis;
+    return true;
+}
+
+HTTPClient *ZoneGroupTopology::_sendGetZoneGroupState() {
+    HTTPClient *client = HTTP::connectionPool.acquire(_deviceIP, 1400, F("/ZoneGroupTopology/Control"));
+    if (!client) {
+        return nullptr;
+    }
+
+    client->addHeader(F("SOAPACTION"), F("urn:schemas-upnp-org:service:ZoneGroupTopology:1#GetZoneGroupState"));
+    int status = client->POST(FPSTR(GET_ZONE_GROUP_STATE));
+
+    Serial.print(F("GetZoneGroupState returned HTTP status "));
+    Serial.println(status);
+    if (status != 200) {
+        HTTP::BodyStream stream(client->getStream(), client->getSize());
+        HTTP::connectionPool.release(client, status > 0 && stream.drain());
+        return nullptr;
+    }
+    return client;
+}
 
-    return result;
+void ZoneGroupTopology::_release(bool consumed) {
+    // the connection can only be reused if the rest of the response has been consumed
+    HTTP::connectionPool.release(_client, consumed && _body->drain());
+    _client = nullptr;
+    _body.reset();
+    _parser.reset();
 }
 
 } // namespace Sonos
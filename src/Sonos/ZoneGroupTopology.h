@@ -1,30 +1,62 @@
 #ifndef SONOS_ZONEGROUPTOPOLOGY_H_
 #define SONOS_ZONEGROUPTOPOLOGY_H_
 
-#include <Arduino.h>
+#include <ESP8266HTTPClient.h>
 #include <IPAddress.h>
-#include <WString.h>
-#include <functional>
+#include <memory>
 
-namespace Sonos {
+#include "../HTTP/BodyStream.h"
+#include "ZoneGroupState.h"
 
-struct ZoneInfo {
-    String uuid;
-    String name;
-    IPAddress playerIP;
-    boolean visible;
-};
+namespace Sonos {
 
 class ZoneGroupTopology {
   public:
-    typedef std::function<void(ZoneInfo info)> ZoneInfoCallback;
+    enum Result {
+        // the response is still being parsed, poll again
+        PENDING,
+        // the whole state has been parsed
+        DONE,
+        // the request failed, timed out or the callback aborted parsing
+        FAILED,
+    };
 
     explicit ZoneGroupTopology(IPAddress deviceIP);
 
-    bool GetZoneGroupState_Decoded(ZoneInfoCallback callback, bool visibleOnly = true);
+    ~ZoneGroupTopology();
+
+    // resumable request of the zone group state, invoking the callback for every (visible) player
+    // only sending the request and receiving the response headers is blocking; the body is parsed by
+    // poll() as it arrives, so a large household doesn't stall the caller
+    bool beginGetZoneGroupState_Decoded(ZoneInfoCallback callback, bool visibleOnly = true, unsigned long timeoutMillis = 5000);
+
+    // resumable lookup of a single (visible) player by UUID, storing its IP address in *playerIP
+    // the connection is closed as soon as the player has been found, instead of reading the rest of the state
+    bool beginFindPlayer(const char *uuid, IPAddress *playerIP, unsigned long timeoutMillis = 5000);
+
+    // advance the pending request
+    Result poll();
+
+    // after poll() returned DONE for a lookup, tells whether the player has been found
+    bool found() const;
+
+    // abort a pending request
+    void end();
 
   private:
     IPAddress _deviceIP;
+
+    // state of a pending resumable request
+    HTTPClient *_client = nullptr;
+    std::unique_ptr<HTTP::BodyStream> _body;
+    std::unique_ptr<ZoneGroupStateParser> _parser;
+    unsigned long _startMillis;
+    unsigned long _timeoutMillis;
+    bool _found = false;
+
+    bool _begin(ZoneGroupStateParser *parser, unsigned long timeoutMillis);
+    HTTPClient *_sendGetZoneGroupState();
+    void _release(bool consumed);
 };
 
 } // namespace Sonos
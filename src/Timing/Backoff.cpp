@@ -0,0 +1,55 @@
+#include "Backoff.h"
+
+namespace Timing {
+
+Backoff::Backoff(unsigned long initialMillis, unsigned long maxMillis) : _initialMillis(initialMillis), _maxMillis(maxMillis) {
+}
+
+void Backoff::seed(uint32_t seed) {
+    // xorshift gets stuck at 0
+    _state = seed ? seed : 1;
+}
+
+bool Backoff::ready(unsigned long nowMillis) const {
+    return !_failures || nowMillis - _failedMillis >= _delayMillis;
+}
+
+void Backoff::failed(unsigned long nowMillis) {
+    // double the delay without overflowing, until it reaches the maximum
+    unsigned long delayMillis = _initialMillis;
+    for (uint16_t i = 0; i < _failures && delayMillis < _maxMillis; i++) {
+        delayMillis = delayMillis < _maxMillis / 2 ? delayMillis * 2 : _maxMillis;
+    }
+    if (delayMillis > _maxMillis) {
+        delayMillis = _maxMillis;
+    }
+
+    if (_failures < UINT16_MAX) {
+        _failures++;
+    }
+    _failedMillis = nowMillis;
+    _delayMillis = delayMillis - _random(delayMillis / 2 + 1);
+}
+
+void Backoff::reset() {
+    _failures = 0;
+    _delayMillis = 0;
+}
+
+uint32_t Backoff::_random(uint32_t bound) {
+    // xorshift32
+    _state ^= _state << 13;
+    _state ^= _state >> 17;
+    _state ^= _state << 5;
+    return bound ? _state % bound : 0;
+}
+
+uint16_t Backoff::failures() const {
+    return _failures;
+}
+
+unsigned long Backoff::delayMillis() const {
+    return _delayMillis;
+}
+
+} /* namespace Timing */
@@ -0,0 +1,47 @@
+#ifndef TIMING_BACKOFF_H_
+#define TIMING_BACKOFF_H_
+
+#include <cstdint>
+
+namespace Timing {
+
+// retry policy: the delay after a failed attempt doubles up to a maximum, and is randomized to between half and all of it
+// devices seeding the jitter differently (e.g. with their chip ID) drift apart, even if they all fail at the same time
+class Backoff {
+  public:
+    Backoff(unsigned long initialMillis, unsigned long maxMillis);
+
+    // seed for the jitter; devices retrying in lockstep should use different seeds
+    void seed(uint32_t seed);
+
+    // whether the next attempt is due; true until the first failure
+    bool ready(unsigned long nowMillis) const;
+
+    // schedule the next attempt after a failure at the given time
+    void failed(unsigned long nowMillis);
+
+    // start over with the initial delay and an immediate attempt
+    void reset();
+
+    // consecutive failures since the last reset
+    uint16_t failures() const;
+
+    // delay before the next attempt, as chosen at the latest failure
+    unsigned long delayMillis() const;
+
+  private:
+    unsigned long _initialMillis;
+    unsigned long _maxMillis;
+
+    uint32_t _state = 1;
+    uint16_t _failures = 0;
+    unsigned long _failedMillis = 0;
+    unsigned long _delayMillis = 0;
+
+    // random number in [0, bound)
+    uint32_t _random(uint32_t bound);
+};
+
+} /* namespace Timing */
+
+#endif /* TIMING_BACKOFF_H_ */
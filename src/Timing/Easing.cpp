@@ -0,0 +1,66 @@
+#include "Easing.h"
+
+namespace Timing {
+
+// beyond this many time constants, the remaining distance is below 1/65536 of the initial one
+static const uint8_t SETTLE_TIME_CONSTANTS = 12;
+
+// exp(-1/tau) is approximated by 1 - 1/tau, which makes the approach marginally faster (0.6% after one time constant of 80 ms)
+Easing::Easing(uint16_t timeConstantMillis)
+    : _decay(timeConstantMillis > 1 ? 65536 - (65536 + timeConstantMillis / 2) / timeConstantMillis : 0), _timeConstantMillis(timeConstantMillis) {
+}
+
+void Easing::set(int32_t value) {
+    _value = value;
+    _target = value;
+}
+
+void Easing::setTarget(int32_t target, unsigned long nowMillis) {
+    if (_value == _target) {
+        _started = true;
+        _lastMillis = nowMillis;
+    }
+    _target = target;
+}
+
+int32_t Easing::update(unsigned long nowMillis) {
+    unsigned long elapsedMillis = _started ? nowMillis - _lastMillis : 0;
+    _started = true;
+    _lastMillis = nowMillis;
+    if (_value == _target || !elapsedMillis) {
+        return _value;
+    }
+    if (elapsedMillis >= static_cast<unsigned long>(SETTLE_TIME_CONSTANTS) * _timeConstantMillis) {
+        _value = _target;
+        return _value;
+    }
+
+    // decay^elapsed by repeated squaring, a handful of multiplications even for long frames
+    uint32_t factor = 65536;
+    uint32_t base = _decay;
+    for (unsigned long n = elapsedMillis; n; n >>= 1) {
+        if (n & 1) {
+            factor = (static_cast<uint64_t>(factor) * base) >> 16;
+        }
+        base = (static_cast<uint64_t>(base) * base) >> 16;
+    }
+
+    // the remaining distance is truncated towards zero, so the target is always reached, without overshooting
+    int64_t remaining = static_cast<int64_t>(_target) - _value;
+    _value = _target - static_cast<int32_t>(remaining * factor / 65536);
+    return _value;
+}
+
+int32_t Easing::value() const {
+    return _value;
+}
+
+int32_t Easing::target() const {
+    return _target;
+}
+
+bool Easing::settled() const {
+    return _value == _target;
+}
+
+} /* namespace Timing */
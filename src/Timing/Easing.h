@@ -0,0 +1,44 @@
+#ifndef TIMING_EASING_H_
+#define TIMING_EASING_H_
+
+#include <cstdint>
+
+namespace Timing {
+
+// exponential approach of a value towards a target, driven by elapsed time rather than by frame count
+// values are fixed point (e.g. Q16 for 0.0 to 1.0), so there is no float math per update
+// a new target simply replaces the previous one, so a burst of targets is followed smoothly without queueing
+class Easing {
+  public:
+    // after timeConstantMillis, the remaining distance to the target has dropped to about 37%
+    explicit Easing(uint16_t timeConstantMillis = 80);
+
+    // jump to the value immediately
+    void set(int32_t value);
+
+    // approach the target from the current value
+    // a settled value starts moving at nowMillis, so the time it has been idle doesn't make it jump
+    void setTarget(int32_t target, unsigned long nowMillis);
+
+    // advance to the given time and return the current value
+    int32_t update(unsigned long nowMillis);
+
+    int32_t value() const;
+    int32_t target() const;
+    bool settled() const;
+
+  private:
+    // Q16 factor for the distance remaining after one millisecond
+    uint32_t _decay;
+    uint16_t _timeConstantMillis;
+
+    int32_t _value = 0;
+    int32_t _target = 0;
+
+    bool _started = false;
+    unsigned long _lastMillis;
+};
+
+} /* namespace Timing */
+
+#endif /* TIMING_EASING_H_ */
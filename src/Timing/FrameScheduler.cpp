@@ -0,0 +1,61 @@
+#include "FrameScheduler.h"
+
+#include <Arduino.h>
+#include <algorithm>
+
+namespace Timing {
+
+FrameScheduler::FrameScheduler(unsigned long periodMicros, Policy policy, uint8_t maxFrames)
+    : _periodMicros(periodMicros), _policy(policy), _maxFrames(maxFrames ? maxFrames : 1) {
+}
+
+uint8_t FrameScheduler::poll() {
+    unsigned long now = micros();
+    if (!_started) {
+        _nextFrameMicros = now;
+        _started = true;
+    }
+
+    // signed difference, so this also works across the micros() overflow
+    long lateness = static_cast<long>(now - _nextFrameMicros);
+    if (lateness < 0) {
+        return 0;
+    }
+
+    _maxJitterMicros = std::max(_maxJitterMicros, static_cast<unsigned long>(lateness));
+    _averageJitterScaled += lateness - (_averageJitterScaled >> _JITTER_AVERAGE_SHIFT);
+
+    // the due frame plus every period that has fully elapsed since
+    unsigned long missed = lateness / _periodMicros;
+    uint8_t frames = 1;
+    if (_policy == CATCH_UP) {
+        frames = std::min(missed + 1, static_cast<unsigned long>(_maxFrames));
+    }
+    _framesSkipped += missed + 1 - frames;
+
+    // schedule the next frame after the last one that is due (or dropped)
+    _nextFrameMicros += (missed + 1) * _periodMicros;
+
+    return frames;
+}
+
+uint32_t FrameScheduler::framesSkipped() const {
+    return _framesSkipped;
+}
+
+unsigned long FrameScheduler::maxJitterMicros() const {
+    return _maxJitterMicros;
+}
+
+unsigned long FrameScheduler::averageJitterMicros() const {
+    return _averageJitterScaled >> _JITTER_AVERAGE_SHIFT;
+}
+
+void FrameScheduler::restart() {
+    _started = false;
+    _framesSkipped = 0;
+    _maxJitterMicros = 0;
+    _averageJitterScaled = 0;
+}
+
+} // namespace Timing
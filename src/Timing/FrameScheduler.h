@@ -0,0 +1,54 @@
+#ifndef TIMING_FRAMESCHEDULER_H_
+#define TIMING_FRAMESCHEDULER_H_
+
+#include <cstdint>
+
+namespace Timing {
+
+// fixed timestep frame scheduler, polled from loop()
+// frames are due at multiples of the period, so a late frame doesn't shift the following ones
+class FrameScheduler {
+  public:
+    enum Policy {
+        // report all missed frames (up to maxFrames), so the caller can advance its animation accordingly
+        CATCH_UP,
+        // drop missed frames and continue with the next one due
+        SKIP,
+    };
+
+    explicit FrameScheduler(unsigned long periodMicros, Policy policy = SKIP, uint8_t maxFrames = 1);
+
+    // returns the number of frames that are due now (0 if none)
+    // the caller is expected to render once, advancing its animation by that many frames
+    uint8_t poll();
+
+    // number of frames that were dropped because they were missed
+    uint32_t framesSkipped() const;
+
+    // lateness of the frames relative to their scheduled time
+    unsigned long maxJitterMicros() const;
+    unsigned long averageJitterMicros() const;
+
+    // start over after the main loop has been blocked on purpose, e.g. by a firmware upload
+    // the next poll() returns a single frame right away, and the statistics don't include the stall
+    void restart();
+
+  private:
+    unsigned long _periodMicros;
+    Policy _policy;
+    uint8_t _maxFrames;
+
+    bool _started = false;
+    unsigned long _nextFrameMicros;
+
+    uint32_t _framesSkipped = 0;
+    unsigned long _maxJitterMicros = 0;
+    // exponential moving average, scaled by 2^_JITTER_AVERAGE_SHIFT
+    unsigned long _averageJitterScaled = 0;
+
+    static const uint8_t _JITTER_AVERAGE_SHIFT = 4;
+};
+
+} // namespace Timing
+
+#endif /* TIMING_FRAMESCHEDULER_H_ */
@@ -5,8 +5,8 @@
 #include <HardwareSerial.h>
 #include <Print.h>
 #include <WString.h>
-#include <WiFiUdp.h>
 #include <cstring>
+#include <lwip/err.h>
 #include <memory>
 #include <pgmspace.h>
 #include <stddef.h>
@@ -20,50 +20,198 @@ const char DISCOVER_MSEARCH[] PROGMEM = "M-SEARCH * HTTP/1.1\r\n"
                                         "ST: %s\r\n"
                                         "\r\n";
 
-bool Discover::all(Callback callback, const char *st, uint8_t mx, unsigned long timeoutMillis) {
-    WiFiUDP udp;
+// read-only stream over a received packet, so the callback parses it in place
+class PacketStream : public Stream {
+  public:
+    explicit PacketStream(pbuf *data) : _data(data) {
+    }
 
-    // start UDP connection on a random port
-    if (!udp.begin(0)) {
-        Serial.println(F("udp.begin failed"));
-        udp.stop();
-        return false;
+    int available() override {
+        return _data->tot_len - _position;
     }
 
-    // UPnP mandates a TTL value of 4
-    if (!udp.beginPacketMulticast(IPAddress(239, 255, 255, 250), 1900, WiFi.localIP(), 4)) {
-        Serial.println(F("udp.beginPacketMulticast failed"));
-        udp.stop();
+    int read() override {
+        return _position < _data->tot_len ? pbuf_get_at(_data, _position++) : -1;
+    }
+
+    int peek() override {
+        return _position < _data->tot_len ? pbuf_get_at(_data, _position) : -1;
+    }
+
+    size_t readBytes(char *buffer, size_t length) override {
+        size_t count = pbuf_copy_partial(_data, buffer, length, _position);
+        _position += count;
+        return count;
+    }
+
+    size_t write(uint8_t) override {
+        return 0;
+    }
+
+  private:
+    pbuf *_data;
+    uint16_t _position = 0;
+};
+
+Discover::~Discover() {
+    end();
+}
+
+bool Discover::begin(const char *st, uint8_t mx, unsigned long timeoutMillis, uint8_t transmissions) {
+    end();
+    _responses = 0;
+    _dropped = 0;
+    _busyMicros = 0;
+    _transmissions = 0;
+    unsigned long startMicros = micros();
+
+    // listen on a random port, responses are unicast to it
+    _pcb = udp_new();
+    if (!_pcb) {
+        Serial.println(F("udp_new failed"));
+        return false;
+    }
+    if (udp_bind(_pcb, IP_ADDR_ANY, 0) != ERR_OK) {
+        Serial.println(F("udp_bind failed"));
+        end();
         return false;
     }
+    udp_recv(_pcb, &Discover::_receive, this);
+
+    // UPnP mandates a TTL value of 4
+    ip_addr_t localIP = WiFi.localIP();
+    udp_set_multicast_netif_addr(_pcb, ip_2_ip4(&localIP));
+    udp_set_multicast_ttl(_pcb, 4);
 
     size_t size = sizeof(DISCOVER_MSEARCH) + (3 * sizeof(mx) - 2) + (strlen(st) - 2);
-    std::unique_ptr<char[]> buf(new char[size]);
-    snprintf_P(buf.get(), size, DISCOVER_MSEARCH, mx, st);
+    _request.reset(new char[size]);
+    _requestLength = snprintf_P(_request.get(), size, DISCOVER_MSEARCH, mx, st);
 
     // send the M-SEARCH request packet
-    udp.write(buf.get());
+    if (!_send()) {
+        end();
+        return false;
+    }
 
-    if (!udp.endPacket()) {
-        Serial.println(F("udp.endPacket failed"));
-        udp.stop();
+    _startMillis = millis();
+    _timeoutMillis = timeoutMillis;
+    _maxTransmissions = transmissions;
+    _retransmitMillis = transmissions > 1 ? mx * 1000UL / transmissions : 0;
+    _running = true;
+    _busyMicros += micros() - startMicros;
+    return true;
+}
+
+bool Discover::poll(const Callback &callback) {
+    if (!_running) {
         return false;
     }
 
-    unsigned long startMillis = millis();
-    while (millis() - startMillis < timeoutMillis) {
-        size_t packetSize = udp.parsePacket();
-        if (packetSize) {
-            bool keepGoing = callback(udp.remoteIP(), udp);
-            udp.flush();
+    if (_queueLength) {
+        unsigned long startMicros = micros();
+        while (_queueLength) {
+            _Packet packet = _queue[_queueHead];
+            _queueHead = (_queueHead + 1) % _QUEUE_SIZE;
+            _queueLength--;
+
+            PacketStream stream(packet.data);
+            bool keepGoing = callback(packet.remoteIP, stream);
+            pbuf_free(packet.data);
+            _responses++;
             if (!keepGoing) {
-                break;
+                _busyMicros += micros() - startMicros;
+                end();
+                return false;
             }
         }
+        _busyMicros += micros() - startMicros;
+    }
+
+    if (millis() - _startMillis >= _timeoutMillis) {
+        end();
+        return false;
     }
 
-    udp.stop();
+    // a lost request or lost responses get another chance within the same window
+    if (_transmissions < _maxTransmissions && millis() - _startMillis >= _transmissions * _retransmitMillis) {
+        unsigned long startMicros = micros();
+        _send();
+        _busyMicros += micros() - startMicros;
+    }
     return true;
 }
 
+void Discover::end() {
+    if (_pcb) {
+        udp_remove(_pcb);
+        _pcb = nullptr;
+    }
+    _request.reset();
+    _clearQueue();
+    _running = false;
+}
+
+bool Discover::running() const {
+    return _running;
+}
+
+uint8_t Discover::transmissions() const {
+    return _transmissions;
+}
+
+uint16_t Discover::responses() const {
+    return _responses;
+}
+
+uint16_t Discover::dropped() const {
+    return _dropped;
+}
+
+uint32_t Discover::busyMicros() const {
+    return _busyMicros;
+}
+
+bool Discover::_send() {
+    // counted even if it fails, so a failing retransmission isn't retried in every poll
+    _transmissions++;
+    // the network stack prepends its headers to the packet, so it can't be sent twice
+    pbuf *request = pbuf_alloc(PBUF_TRANSPORT, _requestLength, PBUF_RAM);
+    if (!request) {
+        Serial.println(F("pbuf_alloc failed"));
+        return false;
+    }
+    pbuf_take(request, _request.get(), _requestLength);
+    ip_addr_t group;
+    IP_ADDR4(&group, 239, 255, 255, 250);
+    err_t err = udp_sendto(_pcb, request, &group, 1900);
+    pbuf_free(request);
+    if (err != ERR_OK) {
+        Serial.println(F("udp_sendto failed"));
+        return false;
+    }
+    return true;
+}
+
+// called by the network stack whenever loop() yields; poll() only does so from the callback, when the queue is consistent
+void Discover::_receive(void *arg, udp_pcb *pcb, pbuf *data, const ip_addr_t *addr, u16_t port) {
+    Discover *discover = static_cast<Discover *>(arg);
+    if (discover->_queueLength == _QUEUE_SIZE) {
+        pbuf_free(data);
+        discover->_dropped++;
+        return;
+    }
+    // the queue takes over the packet, it is freed once it has been handled
+    discover->_queue[(discover->_queueHead + discover->_queueLength) % _QUEUE_SIZE] = {data, IPAddress(addr)};
+    discover->_queueLength++;
+}
+
+void Discover::_clearQueue() {
+    while (_queueLength) {
+        pbuf_free(_queue[_queueHead].data);
+        _queueHead = (_queueHead + 1) % _QUEUE_SIZE;
+        _queueLength--;
+    }
+    _queueHead = 0;
+}
+
 } // namespace UPnP
@@ -5,6 +5,11 @@
 #include <Stream.h>
 #include <cstdint>
 #include <functional>
+#include <lwip/ip_addr.h>
+#include <lwip/pbuf.h>
+#include <lwip/udp.h>
+#include <memory>
+#include <stddef.h>
 
 namespace UPnP {
 
@@ -13,11 +18,66 @@ class Discover {
     // discovery callback type
     typedef std::function<bool(IPAddress remoteIP, Stream &stream)> Callback;
 
-    // perform SSDP discovery using the given ST and MX values
-    // for every response received within the timeout, the callback is invoked
-    // if the callback returns false, discovery is terminated
-    // returns false if discovery failed; not receiving any response is NOT considered a failure
-    static bool all(Callback callback, const char *st, uint8_t mx = 4, unsigned long timeoutMillis = 5000);
+    Discover() = default;
+    Discover(const Discover &) = delete;
+    Discover &operator=(const Discover &) = delete;
+    ~Discover();
+
+    // start a resumable discovery using the given ST and MX values; responses are handled by poll()
+    // not receiving any response is NOT considered a failure
+    // as UDP may be lost, the M-SEARCH request is sent the given number of times, spread evenly over the MX window
+    // returns false if the M-SEARCH request could not be sent
+    bool begin(const char *st, uint8_t mx = 4, unsigned long timeoutMillis = 5000, uint8_t transmissions = 1);
+
+    // invoke the callback for the responses received so far, without waiting for more
+    // responses are queued by the network stack as they arrive, so a poll without any is nearly free
+    // returns true while discovery is running, i.e. until the timeout elapses or the callback returns false
+    bool poll(const Callback &callback);
+
+    // stop discovery early
+    void end();
+
+    bool running() const;
+
+    // statistics of the latest discovery
+    uint8_t transmissions() const;
+    uint16_t responses() const;
+    uint16_t dropped() const;
+    uint32_t busyMicros() const;
+
+  private:
+    struct _Packet {
+        pbuf *data;
+        IPAddress remoteIP;
+    };
+
+    // responses arriving faster than they are polled are dropped beyond this
+    static const uint8_t _QUEUE_SIZE = 4;
+
+    udp_pcb *_pcb = nullptr;
+    bool _running = false;
+    unsigned long _startMillis;
+    unsigned long _timeoutMillis;
+
+    // the request is kept for retransmissions
+    std::unique_ptr<char[]> _request;
+    size_t _requestLength = 0;
+    uint8_t _transmissions = 0;
+    uint8_t _maxTransmissions = 0;
+    unsigned long _retransmitMillis = 0;
+
+    // filled by the receive callback, emptied by poll()
+    _Packet _queue[_QUEUE_SIZE];
+    uint8_t _queueHead = 0;
+    uint8_t _queueLength = 0;
+
+    uint16_t _responses = 0;
+    uint16_t _dropped = 0;
+    uint32_t _busyMicros = 0;
+
+    bool _send();
+    static void _receive(void *arg, udp_pcb *pcb, pbuf *data, const ip_addr_t *addr, u16_t port);
+    void _clearQueue();
 };
 
 } // namespace UPnP
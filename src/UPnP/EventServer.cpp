@@ -3,11 +3,18 @@
 #include <Arduino.h>
 #include <ESP8266HTTPClient.h>
 #include <ESP8266WiFi.h>
+#include <Esp.h>
 #include <HardwareSerial.h>
 #include <Print.h>
 #include <WiFiClient.h>
+#include <algorithm>
+#include <ctype.h>
 #include <pgmspace.h>
 #include <stdlib.h>
+#include <string.h>
+
+#include "../HTTP/BodyStream.h"
+#include "../HTTP/ConnectionPool.h"
 
 namespace UPnP {
 
@@ -23,7 +30,9 @@ EventServer::~EventServer() {
 
 static unsigned int extractTimeoutSeconds(String timeoutResponseHeaderValue, unsigned int defaultValue) {
     if (timeoutResponseHeaderValue.startsWith("Second-")) {
-        return atoi(timeoutResponseHeaderValue.c_str() + 7);
+        // e.g. "Second-infinite", which would cause a renewal in every loop
+        unsigned int timeoutSeconds = atoi(timeoutResponseHeaderValue.c_str() + 7);
+        return timeoutSeconds ? timeoutSeconds : defaultValue;
     }
     Serial.println(F("received TIMEOUT header without prefix; using default value"));
     return defaultValue;
@@ -31,33 +40,32 @@ static unsigned int extractTimeoutSeconds(String timeoutResponseHeaderValue, uns
 
 bool EventServer::subscribe(const EventCallback &callback, const String &subscriptionURL, String *SID, unsigned int timeoutSeconds, double renewalThreshold) {
     bool result = false;
-    WiFiClient wifiClient;
-    HTTPClient http;
-    if (http.begin(wifiClient, subscriptionURL)) {
-        http.addHeader(F("NT"), F("upnp:event"));
-        http.addHeader(F("CALLBACK"), String(F("<http://")) + WiFi.localIP().toString() + ':' + String(_callbackPort) + '>');
-        http.addHeader(F("TIMEOUT"), String(F("Second-")) + String(timeoutSeconds));
+    HTTPClient *http = HTTP::connectionPool.acquire(subscriptionURL);
+    if (http) {
+        http->addHeader(F("NT"), F("upnp:event"));
+        http->addHeader(F("CALLBACK"), String(F("<http://")) + WiFi.localIP().toString() + ':' + String(_callbackPort) + '>');
+        http->addHeader(F("TIMEOUT"), String(F("Second-")) + String(timeoutSeconds));
         const char *headerKeys[] = {"SID", "TIMEOUT"};
-        http.collectHeaders(headerKeys, 2);
-        int status = http.sendRequest("SUBSCRIBE");
+        http->collectHeaders(headerKeys, 2);
+        int status = http->sendRequest("SUBSCRIBE");
         Serial.print(F("EventServer::subscribe() -> status "));
         Serial.println(status);
         if (status == 200) {
-            String newSID = http.header("SID");
+            String newSID = http->header("SID");
             if (newSID != "") {
                 // check map for existing SID
                 if (_subscriptionForSID.find(newSID) == _subscriptionForSID.end()) {
-                    unsigned int actualTimeoutSeconds = extractTimeoutSeconds(http.header("TIMEOUT"), timeoutSeconds);
+                    unsigned int actualTimeoutSeconds = extractTimeoutSeconds(http->header("TIMEOUT"), timeoutSeconds);
                     // populate subscription
                     _Subscription sub;
                     sub._callback = callback;
                     sub._subscriptionURL = subscriptionURL;
-                    sub._startMillis = millis();
-                    sub._renewalAfterMillis = renewalThreshold * 1000.0 * actualTimeoutSeconds;
                     sub._timeoutSeconds = timeoutSeconds;
                     sub._renewalThreshold = renewalThreshold;
+                    sub._retryBackoff.seed(ESP.getChipId() ^ micros());
                     // insert subscription into map
                     _subscriptionForSID[newSID] = sub;
+                    _scheduleRenewal(newSID, _subscriptionForSID[newSID], actualTimeoutSeconds);
                     if (SID) {
                         *SID = newSID;
                     }
@@ -67,7 +75,9 @@ bool EventServer::subscribe(const EventCallback &callback, const String &subscri
                 Serial.println(F("missing SID header value"));
             }
         }
-        http.end();
+        // the response body is usually empty, but must be consumed for the connection to be reused
+        HTTP::BodyStream body(http->getStream(), http->getSize());
+        HTTP::connectionPool.release(http, status > 0 && body.drain());
     }
     return result;
 }
@@ -76,24 +86,24 @@ bool EventServer::_renew(const String &SID, _Subscription &sub) {
     bool result = false;
     Serial.print(F("renewing subscription for SID "));
     Serial.println(SID);
-    WiFiClient wifiClient;
-    HTTPClient http;
-    if (http.begin(wifiClient, sub._subscriptionURL)) {
-        http.addHeader(F("SID"), SID);
-        http.addHeader(F("TIMEOUT"), String(F("Second-")) + String(sub._timeoutSeconds));
+    HTTPClient *http = HTTP::connectionPool.acquire(sub._subscriptionURL);
+    if (http) {
+        http->addHeader(F("SID"), SID);
+        http->addHeader(F("TIMEOUT"), String(F("Second-")) + String(sub._timeoutSeconds));
         const char *headerKeys[] = {"TIMEOUT"};
-        http.collectHeaders(headerKeys, 1);
-        int status = http.sendRequest("SUBSCRIBE");
+        http->collectHeaders(headerKeys, 1);
+        int status = http->sendRequest("SUBSCRIBE");
         Serial.print(F("renew subscription -> status "));
         Serial.println(status);
         if (status == 200) {
-            unsigned int actualTimeoutSeconds = extractTimeoutSeconds(http.header("TIMEOUT"), sub._timeoutSeconds);
+            unsigned int actualTimeoutSeconds = extractTimeoutSeconds(http->header("TIMEOUT"), sub._timeoutSeconds);
             // update subscription entry
-            sub._startMillis = millis();
-            sub._renewalAfterMillis = sub._renewalThreshold * 1000.0 * actualTimeoutSeconds;
+            _scheduleRenewal(SID, sub, actualTimeoutSeconds);
             result = true;
         }
-        http.end();
+        // the response body is usually empty, but must be consumed for the connection to be reused
+        HTTP::BodyStream body(http->getStream(), http->getSize());
+        HTTP::connectionPool.release(http, status > 0 && body.drain());
     }
     return result;
 }
@@ -109,17 +119,18 @@ bool EventServer::renew(const String &SID) {
 
 bool EventServer::_unsubscribe(const String &SID, const _Subscription &sub) {
     bool result = false;
-    WiFiClient wifiClient;
-    HTTPClient http;
-    if (http.begin(wifiClient, sub._subscriptionURL)) {
-        http.addHeader(F("SID"), SID);
-        int status = http.sendRequest("UNSUBSCRIBE");
+    HTTPClient *http = HTTP::connectionPool.acquire(sub._subscriptionURL);
+    if (http) {
+        http->addHeader(F("SID"), SID);
+        int status = http->sendRequest("UNSUBSCRIBE");
         Serial.println(F("EventServer::unsubscribe() -> status "));
         Serial.println(status);
         if (status == 200) {
             result = true;
         }
-        http.end();
+        // the response body is usually empty, but must be consumed for the connection to be reused
+        HTTP::BodyStream body(http->getStream(), http->getSize());
+        HTTP::connectionPool.release(http, status > 0 && body.drain());
     }
     return result;
 }
@@ -128,15 +139,21 @@ bool EventServer::unsubscribe(const String &SID) {
     bool result = false;
     auto subIt = _subscriptionForSID.find(SID);
     if (subIt != _subscriptionForSID.end()) {
-        if (_unsubscribe(subIt->first, subIt->second)) {
-            _subscriptionForSID.erase(subIt);
-            result = true;
+        if (_renewal.state != _RS_IDLE && _renewal.SID == SID) {
+            _renewal.client.stop();
+            _renewal.state = _RS_IDLE;
         }
+        result = _unsubscribe(subIt->first, subIt->second);
+        // forget it anyway, so no more events are delivered for it; the publisher drops it when it expires
+        _subscriptionForSID.erase(subIt);
     }
     return result;
 }
 
 void EventServer::unsubscribeAll() {
+    _renewal.client.stop();
+    _renewal.state = _RS_IDLE;
+    _renewalQueue.clear();
     auto subIt = _subscriptionForSID.begin();
     while (subIt != _subscriptionForSID.end()) {
         _unsubscribe(subIt->first, subIt->second);
@@ -168,108 +185,401 @@ static void sendPreconditionFailed(WiFiClient &client) {
     sendResponse(client, 412, F("Precondition Failed"));
 }
 
+static void sendServiceUnavailable(WiFiClient &client) {
+    sendResponse(client, 503, F("Service Unavailable"));
+}
+
+void EventServer::onDrop(const DropCallback &callback) {
+    _dropCallback = callback;
+}
+
 void EventServer::handleEvent() {
-    WiFiClient client = accept();
-    if (client) {
-        // read request line
-        String requestLine = client.readStringUntil('\n');
-        if (requestLine != F("NOTIFY / HTTP/1.0\r") && requestLine != F("NOTIFY / HTTP/1.1\r")) {
-            Serial.println(F("invalid request line"));
-            Serial.print("\"");
-            Serial.print(requestLine);
-            Serial.println("\"");
-            Serial.print("available: ");
-            Serial.println(client.available());
-            Serial.print("status: ");
-            Serial.println(client.status());
-            sendBadRequest(client);
-            return;
+    _accept();
+    for (_Connection &connection : _connections) {
+        if (connection.state != _CS_FREE) {
+            _process(connection);
         }
+    }
 
-        // read headers
-        String SID = "";
-        bool NTPresent = false;
-        String NT = "";
-        bool NTSPresent = false;
-        String NTS = "";
-        while (true) {
-            String headerLine = client.readStringUntil('\n');
-            if (headerLine == F("\r")) {
-                break;
-            }
-            if (!headerLine.endsWith(F("\r"))) {
-                Serial.println(F("invalid header line"));
-                sendBadRequest(client);
-                return;
-            }
+    _processRenewal();
 
-            // parse header line
-            int sepPos = headerLine.indexOf(':');
-            if (sepPos < 0) {
-                Serial.println(F("invalid header line"));
-                sendBadRequest(client);
-                return;
-            }
-            String headerName = headerLine.substring(0, sepPos);
-            String headerValue = headerLine.substring(sepPos + 1);
-            headerValue.trim();
-            if (headerName == "SID") {
-                SID = headerValue;
-            } else if (headerName == "NT") {
-                NT = headerValue;
-                NTPresent = true;
-            } else if (headerName == "NTS") {
-                NTS = headerValue;
-                NTSPresent = true;
-            }
+    // only the earliest deadline needs to be checked; the next renewal starts once the previous one is done
+    if (_renewal.state == _RS_IDLE && !_renewalQueue.empty() && static_cast<long>(millis() - _renewalQueue.front().dueMillis) >= 0) {
+        std::pop_heap(_renewalQueue.begin(), _renewalQueue.end(), _later);
+        _RenewalDeadline deadline = _renewalQueue.back();
+        _renewalQueue.pop_back();
+        // skip the entries of removed or rescheduled subscriptions
+        auto subIt = _subscriptionForSID.find(deadline.SID);
+        if (subIt != _subscriptionForSID.end() && subIt->second._renewalDueMillis == deadline.dueMillis) {
+            _beginRenewal(subIt->first, subIt->second);
         }
+    }
+}
+
+void EventServer::_schedule(const String &SID, _Subscription &sub, unsigned long delayMillis) {
+    sub._renewalDueMillis = millis() + delayMillis;
+    _renewalQueue.push_back({sub._renewalDueMillis, SID});
+    std::push_heap(_renewalQueue.begin(), _renewalQueue.end(), _later);
+}
+
+void EventServer::_scheduleRenewal(const String &SID, _Subscription &sub, unsigned int actualTimeoutSeconds) {
+    sub._startMillis = millis();
+    sub._expiresAfterMillis = 1000UL * actualTimeoutSeconds;
+    sub._retryBackoff.reset();
+    // up to 5% early, so subscriptions made at the same time (e.g. by displays powered up together) are renewed at different times
+    unsigned long renewalAfterMillis = sub._renewalThreshold * sub._expiresAfterMillis;
+    _schedule(SID, sub, renewalAfterMillis - random(renewalAfterMillis / 20 + 1));
+}
+
+void EventServer::_beginRenewal(const String &SID, _Subscription &sub) {
+    Serial.print(F("renewing subscription for SID "));
+    Serial.println(SID);
+    _renewal.SID = SID;
+    _renewal.status = 0;
+    _renewal.timeoutSeconds = sub._timeoutSeconds;
+    _renewal.line.clear();
+
+    IPAddress host;
+    uint16_t port;
+    String path;
+    if (!HTTP::parseURL(sub._subscriptionURL, &host, &port, &path)) {
+        _endRenewal(false);
+        return;
+    }
+    // connecting is the only step that blocks, which is brief on the local network
+    _renewal.client.setTimeout(_RENEWAL_CONNECT_TIMEOUT_MILLIS);
+    if (!_renewal.client.connect(host, port)) {
+        Serial.println(F("renewal connection failed"));
+        _endRenewal(false);
+        return;
+    }
+    _renewal.client.setNoDelay(true);
+
+    String request = String(F("SUBSCRIBE ")) + path + F(" HTTP/1.1\r\nHOST: ") + host.toString() + ':' + String(port) + F("\r\nSID: ") + SID +
+                     F("\r\nTIMEOUT: Second-") + String(sub._timeoutSeconds) + F("\r\nCONTENT-LENGTH: 0\r\nCONNECTION: close\r\n\r\n");
+    if (_renewal.client.write(request.c_str(), request.length()) != request.length()) {
+        Serial.println(F("renewal request failed"));
+        _endRenewal(false);
+        return;
+    }
+    _renewal.state = _RS_STATUS_LINE;
+    _renewal.deadlineMillis = millis() + _RENEWAL_TIMEOUT_MILLIS;
+}
+
+void EventServer::_processRenewal() {
+    if (_renewal.state == _RS_IDLE) {
+        return;
+    }
+    if (static_cast<long>(millis() - _renewal.deadlineMillis) >= 0) {
+        Serial.println(F("renewal timed out"));
+        _endRenewal(false);
+        return;
+    }
 
-        if (!NTPresent) {
-            Serial.println(F("NT header missing"));
-            sendBadRequest(client);
+    size_t budget = _HEADER_BYTES_PER_CALL;
+    while (true) {
+        _LineResult result = _readLine(_renewal.client, _renewal.line, budget);
+        if (result == _LR_MORE) {
+            if (!_renewal.client.connected() && !_renewal.client.available()) {
+                Serial.println(F("renewal response incomplete"));
+                _endRenewal(false);
+            }
             return;
         }
-        if (!NTSPresent) {
-            Serial.println(F("NTS header missing"));
-            sendBadRequest(client);
+        if (result == _LR_INVALID) {
+            Serial.println(F("invalid line ending"));
+            _endRenewal(false);
             return;
         }
-        if (NT != F("upnp:event")) {
-            Serial.println(F("illegal NT header value"));
-            sendPreconditionFailed(client);
+
+        char *line = _renewal.line.data;
+        if (_renewal.state == _RS_STATUS_LINE) {
+            // e.g. "HTTP/1.1 200 OK"
+            _renewal.status = _renewal.line.length > 9 && !strncmp_P(line, PSTR("HTTP/1."), 7) ? atoi(line + 9) : 0;
+            _renewal.state = _RS_HEADERS;
+        } else if (!_renewal.line.length && !_renewal.line.truncated) {
+            // the response doesn't have a body
+            _endRenewal(_renewal.status == 200);
             return;
+        } else {
+            char *separator = strchr(line, ':');
+            if (separator) {
+                *separator = '\0';
+                const char *value = separator + 1;
+                while (isspace(*value)) {
+                    value++;
+                }
+                if (!strcasecmp_P(line, PSTR("TIMEOUT"))) {
+                    _renewal.timeoutSeconds = extractTimeoutSeconds(value, _renewal.timeoutSeconds);
+                }
+            }
+        }
+        _renewal.line.clear();
+    }
+}
+
+void EventServer::_endRenewal(bool success) {
+    _renewal.client.stop();
+    _renewal.state = _RS_IDLE;
+    Serial.print(F("renew subscription -> status "));
+    Serial.println(_renewal.status);
+
+    auto subIt = _subscriptionForSID.find(_renewal.SID);
+    if (subIt == _subscriptionForSID.end()) {
+        return;
+    }
+    _Subscription &sub = subIt->second;
+    if (success) {
+        _scheduleRenewal(subIt->first, sub, _renewal.timeoutSeconds);
+        return;
+    }
+
+    // the publisher doesn't know the subscription (any more), e.g. after a restart; otherwise, retry until the grace period is over
+    if (_renewal.status == 412 || millis() - sub._startMillis >= sub._expiresAfterMillis + _GRACE_MILLIS) {
+        Serial.print(F("removing subscription after failed renewal for SID "));
+        Serial.println(subIt->first);
+        _subscriptionForSID.erase(subIt);
+        if (_dropCallback) {
+            _dropCallback(_renewal.SID);
+        }
+        return;
+    }
+    sub._retryBackoff.failed(millis());
+    _schedule(subIt->first, sub, sub._retryBackoff.delayMillis());
+}
+
+bool EventServer::_later(const _RenewalDeadline &a, const _RenewalDeadline &b) {
+    // signed difference, so this also works across the millis() overflow
+    return static_cast<long>(a.dueMillis - b.dueMillis) > 0;
+}
+
+void EventServer::_accept() {
+    for (_Connection &connection : _connections) {
+        if (connection.state != _CS_FREE) {
+            continue;
         }
-        if (NTS != F("upnp:propchange")) {
-            Serial.println(F("illegal NTS header value"));
-            sendPreconditionFailed(client);
+        // further clients wait in the backlog until a slot becomes free
+        connection.client = accept();
+        if (!connection.client) {
             return;
         }
-        auto sub = _subscriptionForSID.find(SID);
-        if (sub == _subscriptionForSID.end()) {
-            Serial.println(F("unexpected SID header value"));
-            sendPreconditionFailed(client);
+        connection.state = _CS_REQUEST_LINE;
+        connection.deadlineMillis = millis() + _REQUEST_TIMEOUT_MILLIS;
+        connection.line.clear();
+        connection.SID = String();
+        connection.NTPresent = false;
+        connection.NTValid = false;
+        connection.NTSPresent = false;
+        connection.NTSValid = false;
+        connection.contentLength = -1;
+        connection.bodyRemaining = -1;
+        connection.parsing = false;
+    }
+}
+
+void EventServer::_process(_Connection &connection) {
+    // signed difference, so this also works across the millis() overflow
+    if (static_cast<long>(millis() - connection.deadlineMillis) >= 0) {
+        Serial.println(F("NOTIFY request timed out"));
+        // an event that was cut short is discarded, the publisher must not take it as delivered
+        if (connection.state == _CS_BODY) {
+            sendServiceUnavailable(connection.client);
+        }
+        _close(connection);
+        return;
+    }
+    // without a length, the sender closing the connection ends the body
+    if (!connection.client.connected() && !connection.client.available() && (connection.state != _CS_BODY || connection.bodyRemaining >= 0)) {
+        Serial.println(F("NOTIFY request incomplete"));
+        _close(connection);
+        return;
+    }
+
+    size_t budget = _HEADER_BYTES_PER_CALL;
+    while (connection.state != _CS_BODY) {
+        _LineResult result = _readLine(connection.client, connection.line, budget);
+        if (result == _LR_MORE) {
+            break;
+        }
+        if (result == _LR_INVALID) {
+            Serial.println(F("invalid line ending"));
+            sendBadRequest(connection.client);
+            _close(connection);
             return;
         }
+        bool accepted = connection.state == _CS_REQUEST_LINE ? _processRequestLine(connection) : _processHeaderLine(connection);
+        if (!accepted) {
+            _close(connection);
+            return;
+        }
+        connection.line.clear();
+    }
 
-        Serial.print(F("invoking callback for SID: "));
-        Serial.println(SID);
-        sub->second._callback(SID, client);
-        sendOK(client);
-    }
-
-    // renew all subscriptions whose _renewalAfterMillis has elapsed
-    for (auto subIt = _subscriptionForSID.begin(); subIt != _subscriptionForSID.end();) {
-        const String &SID = subIt->first;
-        _Subscription &sub = subIt->second;
-        // if renewal is required and it fails, remove the subscription
-        if (millis() - sub._startMillis >= sub._renewalAfterMillis && !_renew(SID, sub)) {
-            Serial.print(F("removing subscription after failed renewal for SID "));
-            Serial.println(SID);
-            subIt = _subscriptionForSID.erase(subIt);
-        } else {
-            ++subIt;
+    if (connection.state == _CS_BODY) {
+        _processBody(connection);
+    }
+}
+
+EventServer::_LineResult EventServer::_readLine(WiFiClient &client, _Line &line, size_t &budget) {
+    for (; budget && client.available(); budget--) {
+        // byte by byte, so a request body is left in the client
+        int ch = client.read();
+        if (ch != '\n') {
+            if (line.length < sizeof(line.data) - 1) {
+                line.data[line.length++] = ch;
+            } else {
+                line.truncated = true;
+            }
+            continue;
+        }
+        budget--;
+
+        // the CR of a truncated line has been dropped along with the rest of it
+        if (!line.truncated) {
+            if (!line.length || line.data[line.length - 1] != '\r') {
+                return _LR_INVALID;
+            }
+            line.length--;
         }
+        line.data[line.length] = '\0';
+        return _LR_COMPLETE;
+    }
+    return _LR_MORE;
+}
+
+bool EventServer::_processRequestLine(_Connection &connection) {
+    if (connection.line.truncated || (strcmp_P(connection.line.data, PSTR("NOTIFY / HTTP/1.0")) && strcmp_P(connection.line.data, PSTR("NOTIFY / HTTP/1.1")))) {
+        Serial.print(F("invalid request line \""));
+        Serial.print(connection.line.data);
+        Serial.println('"');
+        sendBadRequest(connection.client);
+        return false;
+    }
+    connection.state = _CS_HEADERS;
+    return true;
+}
+
+bool EventServer::_processHeaderLine(_Connection &connection) {
+    if (!connection.line.length && !connection.line.truncated) {
+        return _checkHeaders(connection);
+    }
+
+    char *separator = strchr(connection.line.data, ':');
+    if (!separator) {
+        Serial.println(F("invalid header line"));
+        sendBadRequest(connection.client);
+        return false;
     }
+    *separator = '\0';
+    const char *name = connection.line.data;
+    char *value = separator + 1;
+    while (isspace(*value)) {
+        value++;
+    }
+    for (char *end = value + strlen(value); end > value && isspace(end[-1]); end--) {
+        end[-1] = '\0';
+    }
+
+    bool relevant = true;
+    if (!strcasecmp_P(name, PSTR("SID"))) {
+        connection.SID = value;
+    } else if (!strcasecmp_P(name, PSTR("NT"))) {
+        connection.NTPresent = true;
+        connection.NTValid = !strcmp_P(value, PSTR("upnp:event"));
+    } else if (!strcasecmp_P(name, PSTR("NTS"))) {
+        connection.NTSPresent = true;
+        connection.NTSValid = !strcmp_P(value, PSTR("upnp:propchange"));
+    } else if (!strcasecmp_P(name, PSTR("CONTENT-LENGTH"))) {
+        connection.contentLength = atoi(value);
+    } else {
+        relevant = false;
+    }
+    // other headers (e.g. long vendor specific ones) may be cut off, these must not
+    if (relevant && connection.line.truncated) {
+        Serial.println(F("header line too long"));
+        sendBadRequest(connection.client);
+        return false;
+    }
+    return true;
+}
+
+bool EventServer::_checkHeaders(_Connection &connection) {
+    if (!connection.NTPresent) {
+        Serial.println(F("NT header missing"));
+        sendBadRequest(connection.client);
+        return false;
+    }
+    if (!connection.NTSPresent) {
+        Serial.println(F("NTS header missing"));
+        sendBadRequest(connection.client);
+        return false;
+    }
+    if (!connection.NTValid) {
+        Serial.println(F("illegal NT header value"));
+        sendPreconditionFailed(connection.client);
+        return false;
+    }
+    if (!connection.NTSValid) {
+        Serial.println(F("illegal NTS header value"));
+        sendPreconditionFailed(connection.client);
+        return false;
+    }
+    auto sub = _subscriptionForSID.find(connection.SID);
+    if (sub == _subscriptionForSID.end()) {
+        Serial.println(F("unexpected SID header value"));
+        sendPreconditionFailed(connection.client);
+        return false;
+    }
+    connection.state = _CS_BODY;
+    connection.bodyRemaining = connection.contentLength;
+    connection.parser = sub->second._callback(connection.SID);
+    connection.parsing = connection.parser != nullptr;
+    return true;
+}
+
+void EventServer::_processBody(_Connection &connection) {
+    // the body is limited to its length, and handed to the parser in slices as it arrives
+    HTTP::BodyStream body(connection.client, connection.bodyRemaining);
+    HTTP::BodyStream slice(body, _BODY_BYTES_PER_CALL);
+    if (connection.parsing) {
+        connection.parsing = connection.parser->feed(slice);
+    }
+    // the rest is of no interest, but must be consumed before responding
+    if (!connection.parsing) {
+        char buffer[64];
+        for (int available; (available = slice.available()) > 0;) {
+            slice.readBytes(buffer, std::min(available, static_cast<int>(sizeof(buffer))));
+        }
+    }
+    connection.bodyRemaining = body.remaining();
+    bool complete = !connection.bodyRemaining || (connection.bodyRemaining < 0 && !connection.client.connected() && !connection.client.available());
+    if (!complete) {
+        return;
+    }
+
+    // the subscription may have been removed while the request was coming in
+    if (_subscriptionForSID.find(connection.SID) == _subscriptionForSID.end()) {
+        Serial.println(F("unexpected SID header value"));
+        sendPreconditionFailed(connection.client);
+        _close(connection);
+        return;
+    }
+
+    Serial.print(F("received event for SID: "));
+    Serial.println(connection.SID);
+    if (connection.parser) {
+        connection.parser->end();
+    }
+    sendOK(connection.client);
+    _close(connection);
+}
+
+void EventServer::_close(_Connection &connection) {
+    connection.client.stop();
+    connection.client = WiFiClient();
+    connection.SID = String();
+    connection.parser.reset();
+    connection.state = _CS_FREE;
 }
 
 } // namespace UPnP
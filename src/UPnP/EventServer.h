@@ -4,15 +4,36 @@
 #include <IPAddress.h>
 #include <Stream.h>
 #include <WString.h>
+#include <WiFiClient.h>
 #include <WiFiServer.h>
 #include <cstdint>
 #include <functional>
 #include <map>
+#include <memory>
 #include <stddef.h>
+#include <vector>
+
+#include "../Timing/Backoff.h"
 
 namespace UPnP {
 
-typedef std::function<void(String SID, Stream &stream)> EventCallback;
+// parser for the body of a single event, fed a slice at a time from handleEvent() as the body arrives
+class EventParser {
+  public:
+    virtual ~EventParser() {
+    }
+
+    // parse the body data that is already available in the stream, which ends with the body; must not wait for more
+    // returns false once the rest of the body is of no interest
+    virtual bool feed(Stream &stream) = 0;
+
+    // the whole body has arrived; not called if it was cut short, then the event is to be discarded
+    virtual void end() = 0;
+};
+
+// creates the parser for an event of the subscription with the given SID
+typedef std::function<std::unique_ptr<EventParser>(const String &SID)> EventCallback;
+typedef std::function<void(const String &SID)> DropCallback;
 
 class EventServer : public WiFiServer {
   public:
@@ -24,25 +45,98 @@ class EventServer : public WiFiServer {
     // subscribe to an event at the endpoint defined via subscriptionURL
     // should be called after begin() to avoid missing the initial event
     // timeoutSeconds is used in the subscription request
+    // for every event, the callback creates a parser the body is fed to
     // a successful subscription response contains a timeout value; renewalThreshold defines the fraction of that
     // timeout after which an automatic renewal is performed in handleEvents()
+    // renewals run in the background; a failed one is retried until shortly after the subscription has expired
     // if subscription was successful, this function returns true and stores the SID in *SID
     bool subscribe(const EventCallback &callback, const String &subscriptionURL, String *SID = nullptr, unsigned int timeoutSeconds = 3600,
                    double renewalThreshold = 0.9);
 
-    // renew the subscription for the given SID
+    // renew the subscription for the given SID right away, waiting for the response
     bool renew(const String &SID);
 
     // unsubscribe from an event specified by its SID
+    // the subscription is removed even if the publisher can't be reached; returns true if it acknowledged
     bool unsubscribe(const String &SID);
 
     // unsubscribe from all known events
     void unsubscribeAll();
 
+    // set the callback invoked from handleEvent() when a subscription is dropped because it couldn't be renewed
+    // the SID is no longer valid then, no more events are delivered for it
+    void onDrop(const DropCallback &callback);
+
     // handle events and subscription renewal
+    // requests, event bodies and renewal responses are parsed as their data arrives, without waiting for a slow sender
     void handleEvent();
 
   private:
+    // a line of a request or response, without the line break; the rest of an overlong line is dropped
+    struct _Line {
+        char data[128];
+        size_t length = 0;
+        bool truncated = false;
+
+        void clear() {
+            length = 0;
+            truncated = false;
+        }
+    };
+
+    enum _LineResult {
+        // the line isn't complete yet, read again when more data has arrived
+        _LR_MORE,
+        _LR_COMPLETE,
+        // the line doesn't end in CRLF
+        _LR_INVALID,
+    };
+
+    enum _ConnectionState {
+        _CS_FREE,
+        _CS_REQUEST_LINE,
+        _CS_HEADERS,
+        _CS_BODY,
+    };
+
+    // a NOTIFY request in progress
+    struct _Connection {
+        WiFiClient client;
+        _ConnectionState state = _CS_FREE;
+        // the request must be complete by then, otherwise the connection is dropped
+        unsigned long deadlineMillis;
+        _Line line;
+        // headers seen so far
+        String SID;
+        bool NTPresent;
+        bool NTValid;
+        bool NTSPresent;
+        bool NTSValid;
+        int contentLength;
+        // body bytes not received yet, -1 if the length is unknown
+        int bodyRemaining;
+        // false once the parser isn't interested in the rest of the body
+        std::unique_ptr<EventParser> parser;
+        bool parsing;
+    };
+
+    // concurrent requests, e.g. volume and topology events from different players
+    static const uint8_t _CONNECTION_COUNT = 4;
+    static const unsigned long _REQUEST_TIMEOUT_MILLIS = 2000;
+    // header bytes processed per connection and call, bounding the time spent in handleEvent()
+    static const size_t _HEADER_BYTES_PER_CALL = 512;
+    // body bytes processed per connection and call
+    static const int _BODY_BYTES_PER_CALL = 1024;
+
+    // renewal retries start after a few seconds, and are spread over a minute at most
+    static const unsigned long _RETRY_INITIAL_MILLIS = 2000;
+    static const unsigned long _RETRY_MAX_MILLIS = 60000;
+    // a subscription whose renewals keep failing is dropped this long after it has expired at the publisher
+    static const unsigned long _GRACE_MILLIS = 30000;
+    // a renewal must be complete by then, otherwise it is retried
+    static const unsigned long _RENEWAL_TIMEOUT_MILLIS = 5000;
+    static const unsigned long _RENEWAL_CONNECT_TIMEOUT_MILLIS = 1000;
+
     struct _Subscription {
         // callback function
         EventCallback _callback;
@@ -50,19 +144,68 @@ class EventServer : public WiFiServer {
         String _subscriptionURL;
         // latest renewal time of subscription, creation time if not renewed yet
         unsigned long _startMillis;
-        // duration after _startMillis when renewal should be performed
-        unsigned long _renewalAfterMillis;
+        // duration after _startMillis when the publisher drops the subscription
+        unsigned long _expiresAfterMillis;
+        // when the next renewal (or retry) is due; also tells which entry in the renewal queue is the current one
+        unsigned long _renewalDueMillis;
         // timeout to be used for subsequent renewals
         unsigned int _timeoutSeconds;
         // threshold to be used for subsequent renewals
         double _renewalThreshold;
+        // delay of the retries after failed renewals
+        Timing::Backoff _retryBackoff{_RETRY_INITIAL_MILLIS, _RETRY_MAX_MILLIS};
+    };
+
+    // entry of the renewal queue, a min-heap ordered by due time
+    // rescheduling a subscription leaves its previous entry behind, which is skipped when it comes up
+    struct _RenewalDeadline {
+        unsigned long dueMillis;
+        String SID;
+    };
+
+    enum _RenewalState {
+        _RS_IDLE,
+        _RS_STATUS_LINE,
+        _RS_HEADERS,
+    };
+
+    // the renewal in flight; there is at most one at a time
+    struct _Renewal {
+        WiFiClient client;
+        _RenewalState state = _RS_IDLE;
+        String SID;
+        unsigned long deadlineMillis;
+        _Line line;
+        int status;
+        unsigned int timeoutSeconds;
     };
 
     bool _renew(const String &SID, _Subscription &sub);
     bool _unsubscribe(const String &SID, const _Subscription &sub);
 
+    void _schedule(const String &SID, _Subscription &sub, unsigned long delayMillis);
+    void _scheduleRenewal(const String &SID, _Subscription &sub, unsigned int actualTimeoutSeconds);
+    void _beginRenewal(const String &SID, _Subscription &sub);
+    void _processRenewal();
+    void _endRenewal(bool success);
+    static bool _later(const _RenewalDeadline &a, const _RenewalDeadline &b);
+
+    static _LineResult _readLine(WiFiClient &client, _Line &line, size_t &budget);
+
+    void _accept();
+    void _process(_Connection &connection);
+    bool _processRequestLine(_Connection &connection);
+    bool _processHeaderLine(_Connection &connection);
+    bool _checkHeaders(_Connection &connection);
+    void _processBody(_Connection &connection);
+    void _close(_Connection &connection);
+
     uint16_t _callbackPort;
+    DropCallback _dropCallback;
     std::map<String, _Subscription> _subscriptionForSID;
+    std::vector<_RenewalDeadline> _renewalQueue;
+    _Renewal _renewal;
+    _Connection _connections[_CONNECTION_COUNT];
 };
 
 } // namespace UPnP
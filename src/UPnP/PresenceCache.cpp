@@ -0,0 +1,195 @@
+#include "PresenceCache.h"
+
+#include <Arduino.h>
+#include <HardwareSerial.h>
+#include <cctype>
+#include <cstdlib>
+#include <cstring>
+#include <pgmspace.h>
+
+namespace UPnP {
+
+static char *trim(char *s) {
+    while (isspace(*s)) {
+        s++;
+    }
+    for (char *end = s + strlen(s); end > s && isspace(end[-1]); end--) {
+        end[-1] = '\0';
+    }
+    return s;
+}
+
+PresenceCache::PresenceCache(const char *nt, uint8_t capacity) : _nt(nt), _capacity(capacity) {
+}
+
+bool PresenceCache::handle(char *message, const IPAddress &remoteIP, unsigned long nowMillis) {
+    bool notify = false;
+    const char *type = nullptr;
+    const char *subtype = nullptr;
+    const char *usn = nullptr;
+    const char *location = nullptr;
+    unsigned long maxAgeMillis = _DEFAULT_MAX_AGE_MILLIS;
+
+    char *line = message;
+    for (bool first = true; *line; first = false) {
+        char *next = strchr(line, '\n');
+        if (next) {
+            *next++ = '\0';
+        } else {
+            next = line + strlen(line);
+        }
+        line = trim(line);
+
+        if (first) {
+            // only announcements and search responses; other devices' M-SEARCH requests are ignored
+            if (!strcmp_P(line, PSTR("NOTIFY * HTTP/1.1"))) {
+                notify = true;
+            } else if (strncmp_P(line, PSTR("HTTP/1.1 200"), 12)) {
+                return false;
+            }
+        } else if (!*line) {
+            break;
+        } else {
+            char *separator = strchr(line, ':');
+            if (separator) {
+                *separator = '\0';
+                const char *name = trim(line);
+                const char *value = trim(separator + 1);
+                if (!strcasecmp_P(name, notify ? PSTR("NT") : PSTR("ST"))) {
+                    type = value;
+                } else if (!strcasecmp_P(name, PSTR("NTS"))) {
+                    subtype = value;
+                } else if (!strcasecmp_P(name, PSTR("USN"))) {
+                    usn = value;
+                } else if (!strcasecmp_P(name, PSTR("LOCATION"))) {
+                    location = value;
+                } else if (!strcasecmp_P(name, PSTR("CACHE-CONTROL"))) {
+                    maxAgeMillis = _parseMaxAge(value);
+                }
+            }
+        }
+        line = next;
+    }
+
+    if (!type || strcmp(type, _nt) || !usn) {
+        return false;
+    }
+    if (!notify || (subtype && !strcmp_P(subtype, PSTR("ssdp:alive")))) {
+        return location && _alive(usn, location, maxAgeMillis, remoteIP, nowMillis);
+    }
+    if (subtype && !strcmp_P(subtype, PSTR("ssdp:byebye"))) {
+        return _byebye(usn);
+    }
+    return false;
+}
+
+void PresenceCache::expire(unsigned long nowMillis) {
+    for (auto it = _entries.begin(); it != _entries.end();) {
+        if (nowMillis - it->seenMillis >= it->maxAgeMillis) {
+            it = _entries.erase(it);
+        } else {
+            ++it;
+        }
+    }
+}
+
+bool PresenceCache::any(IPAddress *ip, unsigned long nowMillis) {
+    expire(nowMillis);
+    const Entry *newest = nullptr;
+    for (const Entry &entry : _entries) {
+        if (!newest || nowMillis - entry.seenMillis < nowMillis - newest->seenMillis) {
+            newest = &entry;
+        }
+    }
+    if (newest && ip) {
+        *ip = newest->ip;
+    }
+    return newest;
+}
+
+void PresenceCache::remove(const IPAddress &ip) {
+    for (auto it = _entries.begin(); it != _entries.end();) {
+        if (it->ip == ip) {
+            it = _entries.erase(it);
+        } else {
+            ++it;
+        }
+    }
+}
+
+void PresenceCache::clear() {
+    _entries.clear();
+}
+
+const std::vector<PresenceCache::Entry> &PresenceCache::entries() const {
+    return _entries;
+}
+
+bool PresenceCache::_alive(const char *usn, const char *location, unsigned long maxAgeMillis, const IPAddress &remoteIP, unsigned long nowMillis) {
+    expire(nowMillis);
+    for (Entry &entry : _entries) {
+        if (entry.usn == usn) {
+            entry.ip = remoteIP;
+            entry.location = location;
+            entry.seenMillis = nowMillis;
+            entry.maxAgeMillis = maxAgeMillis;
+            return true;
+        }
+    }
+
+    Serial.print(F("device present: "));
+    Serial.println(remoteIP.toString());
+    Entry entry = {remoteIP, usn, location, nowMillis, maxAgeMillis};
+    if (_entries.size() < _capacity) {
+        _entries.push_back(entry);
+        return true;
+    }
+    if (!_capacity) {
+        return false;
+    }
+    // replace the device that would have expired first
+    Entry *oldest = &_entries.front();
+    for (Entry &candidate : _entries) {
+        if (candidate.maxAgeMillis - (nowMillis - candidate.seenMillis) < oldest->maxAgeMillis - (nowMillis - oldest->seenMillis)) {
+            oldest = &candidate;
+        }
+    }
+    *oldest = entry;
+    return true;
+}
+
+bool PresenceCache::_byebye(const char *usn) {
+    for (auto it = _entries.begin(); it != _entries.end(); ++it) {
+        if (it->usn == usn) {
+            Serial.print(F("device gone: "));
+            Serial.println(it->ip.toString());
+            _entries.erase(it);
+            return true;
+        }
+    }
+    return false;
+}
+
+unsigned long PresenceCache::_parseMaxAge(const char *cacheControl) {
+    // e.g. "max-age=1800" or "no-cache=\"Ext\", max-age = 5000"
+    for (const char *p = cacheControl; *p; p++) {
+        if (strncasecmp_P(p, PSTR("max-age"), 7)) {
+            continue;
+        }
+        p += 7;
+        while (isspace(*p)) {
+            p++;
+        }
+        if (*p != '=') {
+            break;
+        }
+        unsigned long seconds = strtoul(p + 1, nullptr, 10);
+        if (!seconds) {
+            break;
+        }
+        return seconds < _MAX_MAX_AGE_MILLIS / 1000 ? seconds * 1000 : _MAX_MAX_AGE_MILLIS;
+    }
+    return _DEFAULT_MAX_AGE_MILLIS;
+}
+
+} // namespace UPnP
@@ -0,0 +1,61 @@
+#ifndef UPNP_PRESENCECACHE_H_
+#define UPNP_PRESENCECACHE_H_
+
+#include <IPAddress.h>
+#include <WString.h>
+#include <cstdint>
+#include <vector>
+
+namespace UPnP {
+
+// devices of one type that announced themselves via SSDP, each kept until its max-age has passed
+// fed with NOTIFY ssdp:alive/ssdp:byebye announcements as well as M-SEARCH responses, so a discovery doesn't always start cold
+class PresenceCache {
+  public:
+    struct Entry {
+        IPAddress ip;
+        String usn;
+        String location;
+        unsigned long seenMillis;
+        unsigned long maxAgeMillis;
+    };
+
+    // nt is the notification (or search) type of the devices to keep, e.g. "urn:schemas-upnp-org:device:ZonePlayer:1"
+    // once capacity devices are known, a new one replaces the device that expires first
+    explicit PresenceCache(const char *nt, uint8_t capacity = 8);
+
+    // handle an SSDP message received from remoteIP; the nul-terminated message is modified while parsing
+    // returns true if a device of the type has been added, refreshed, or removed
+    bool handle(char *message, const IPAddress &remoteIP, unsigned long nowMillis);
+
+    // drop the devices whose max-age has passed
+    void expire(unsigned long nowMillis);
+
+    // if a device is known, store the IP address of the one seen most recently in *ip (if ip is not NULL)
+    bool any(IPAddress *ip, unsigned long nowMillis);
+
+    // forget the device with the given IP address, e.g. because it didn't respond
+    void remove(const IPAddress &ip);
+
+    void clear();
+
+    const std::vector<Entry> &entries() const;
+
+  private:
+    // announcements without a usable max-age are kept for the minimum the UPnP specification recommends
+    static const unsigned long _DEFAULT_MAX_AGE_MILLIS = 1800000;
+    // and no announcement is kept for longer than a day
+    static const unsigned long _MAX_MAX_AGE_MILLIS = 86400000;
+
+    const char *_nt;
+    uint8_t _capacity;
+    std::vector<Entry> _entries;
+
+    bool _alive(const char *usn, const char *location, unsigned long maxAgeMillis, const IPAddress &remoteIP, unsigned long nowMillis);
+    bool _byebye(const char *usn);
+    static unsigned long _parseMaxAge(const char *cacheControl);
+};
+
+} // namespace UPnP
+
+#endif /* UPNP_PRESENCECACHE_H_ */
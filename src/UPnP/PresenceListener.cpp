@@ -0,0 +1,54 @@
+#include "PresenceListener.h"
+
+#include <Arduino.h>
+#include <ESP8266WiFi.h>
+#include <HardwareSerial.h>
+#include <WiFiUdp.h>
+
+namespace UPnP {
+
+PresenceListener::PresenceListener(const char *nt, uint8_t capacity) : _cache(nt, capacity) {
+}
+
+bool PresenceListener::begin() {
+    end();
+    if (!_udp.beginMulticast(WiFi.localIP(), IPAddress(239, 255, 255, 250), 1900)) {
+        Serial.println(F("udp.beginMulticast failed"));
+        _udp.stop();
+        return false;
+    }
+    _listening = true;
+    return true;
+}
+
+void PresenceListener::handle() {
+    if (!_listening) {
+        return;
+    }
+    while (_udp.parsePacket()) {
+        feed(_udp.remoteIP(), _udp);
+        _udp.flush();
+    }
+}
+
+void PresenceListener::end() {
+    if (_listening) {
+        _udp.stop();
+        _listening = false;
+    }
+    _cache.clear();
+}
+
+bool PresenceListener::feed(const IPAddress &remoteIP, Stream &stream) {
+    // only what has been received, so this never waits; a longer message is cut off, the remainder is dropped with the packet
+    int available = stream.available();
+    size_t length = stream.readBytes(_message, available < static_cast<int>(sizeof(_message)) ? available : sizeof(_message) - 1);
+    _message[length] = '\0';
+    return _cache.handle(_message, remoteIP, millis());
+}
+
+PresenceCache &PresenceListener::cache() {
+    return _cache;
+}
+
+} // namespace UPnP
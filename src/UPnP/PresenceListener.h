@@ -0,0 +1,46 @@
+#ifndef UPNP_PRESENCELISTENER_H_
+#define UPNP_PRESENCELISTENER_H_
+
+#include <IPAddress.h>
+#include <Stream.h>
+#include <WiFiUdp.h>
+#include <cstdint>
+#include <stddef.h>
+
+#include "PresenceCache.h"
+
+namespace UPnP {
+
+// passive SSDP listener: joins the multicast group and keeps the cache up to date with the devices' announcements
+class PresenceListener {
+  public:
+    explicit PresenceListener(const char *nt, uint8_t capacity = 8);
+
+    // join 239.255.255.250:1900 on the station interface
+    bool begin();
+
+    // handle the announcements received so far, without waiting for more
+    void handle();
+
+    // leave the multicast group and forget all devices, e.g. when the network is lost
+    void end();
+
+    // read an SSDP message (e.g. an M-SEARCH response) from the stream and hand it to the cache
+    // returns true if the message announced a device of the cache's type
+    bool feed(const IPAddress &remoteIP, Stream &stream);
+
+    PresenceCache &cache();
+
+  private:
+    // Sonos announcements are about 600 bytes, the headers of interest come first in any case
+    static const size_t _MESSAGE_SIZE = 768;
+
+    PresenceCache _cache;
+    WiFiUDP _udp;
+    bool _listening = false;
+    char _message[_MESSAGE_SIZE];
+};
+
+} // namespace UPnP
+
+#endif /* UPNP_PRESENCELISTENER_H_ */
@@ -0,0 +1,77 @@
+#include "CRC32.h"
+
+#include <cstring>
+#include <pgmspace.h>
+
+namespace Util {
+
+static_assert(__BYTE_ORDER__ == __ORDER_LITTLE_ENDIAN__, "slice-by-4 assumes little endian words");
+
+struct Tables {
+    uint32_t entries[4][256];
+};
+
+// entries[0] is the classic byte-wise table, entries[k] advances a byte by k more zero bytes
+static constexpr Tables makeTables() {
+    Tables tables = {};
+    for (uint32_t i = 0; i < 256; i++) {
+        uint32_t crc = i;
+        for (int j = 0; j < 8; j++) {
+            crc = (crc >> 1) ^ (0xEDB88320 & (0 - (crc & 1)));
+        }
+        tables.entries[0][i] = crc;
+    }
+    for (uint32_t i = 0; i < 256; i++) {
+        for (int k = 1; k < 4; k++) {
+            uint32_t previous = tables.entries[k - 1][i];
+            tables.entries[k][i] = (previous >> 8) ^ tables.entries[0][previous & 0xff];
+        }
+    }
+    return tables;
+}
+
+static const Tables TABLES PROGMEM = makeTables();
+
+static inline uint32_t entry(int table, uint8_t index) {
+    return pgm_read_dword(&TABLES.entries[table][index]);
+}
+
+CRC32::CRC32() {
+    reset();
+}
+
+void CRC32::reset() {
+    _crc = 0xffffffff;
+}
+
+CRC32 &CRC32::update(const void *data, size_t length) {
+    const uint8_t *p = reinterpret_cast<const uint8_t *>(data);
+    uint32_t crc = _crc;
+
+    // byte by byte up to the first word boundary, then a word at a time
+    for (; length && (reinterpret_cast<uintptr_t>(p) & 3); length--, p++) {
+        crc = (crc >> 8) ^ entry(0, (crc ^ *p) & 0xff);
+    }
+    for (; length >= 4; length -= 4, p += 4) {
+        uint32_t word;
+        memcpy(&word, p, sizeof(word));
+        crc ^= word;
+        crc = entry(3, crc & 0xff) ^ entry(2, (crc >> 8) & 0xff) ^ entry(1, (crc >> 16) & 0xff) ^ entry(0, crc >> 24);
+    }
+    for (; length; length--, p++) {
+        crc = (crc >> 8) ^ entry(0, (crc ^ *p) & 0xff);
+    }
+
+    _crc = crc;
+    return *this;
+}
+
+uint32_t CRC32::value() const {
+    return _crc ^ 0xffffffff;
+}
+
+uint32_t CRC32::calculate(const void *data, size_t length) {
+    return CRC32().update(data, length).value();
+}
+
+} /* namespace Util */
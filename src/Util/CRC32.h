@@ -0,0 +1,32 @@
+#ifndef UTIL_CRC32_H_
+#define UTIL_CRC32_H_
+
+#include <cstdint>
+#include <stddef.h>
+
+namespace Util {
+
+// CRC-32 (IEEE 802.3, as used by zlib and Ethernet), slice-by-4 with the 4 KB of tables in flash
+// update() can be called repeatedly, so data can be checksummed while it is streamed in
+// the data itself must be in RAM
+class CRC32 {
+  public:
+    CRC32();
+
+    // start over with a new checksum
+    void reset();
+
+    CRC32 &update(const void *data, size_t length);
+
+    // checksum of all data passed to update() so far
+    uint32_t value() const;
+
+    static uint32_t calculate(const void *data, size_t length);
+
+  private:
+    uint32_t _crc;
+};
+
+} /* namespace Util */
+
+#endif /* UTIL_CRC32_H_ */
@@ -0,0 +1,67 @@
+#ifndef UTIL_MAILBOX_H_
+#define UTIL_MAILBOX_H_
+
+#include <atomic>
+#include <cstdint>
+#include <cstring>
+#include <type_traits>
+
+namespace Util {
+
+// single-producer/single-consumer mailbox holding the latest value only (a seqlock)
+// the producer never waits; the consumer retries if it caught the producer in the middle of a post
+// the consumer must not interrupt the producer (e.g. from an ISR), because it would retry forever
+template <typename T> class Mailbox {
+    static_assert(std::is_trivially_copyable<T>::value, "values are copied byte-wise");
+
+  public:
+    // producer: replace the value, a value that hasn't been fetched yet is dropped
+    void post(const T &value) {
+        uint32_t sequence = _sequence.load(std::memory_order_relaxed);
+        // odd while the value is written
+        _sequence.store(sequence + 1, std::memory_order_relaxed);
+        std::atomic_thread_fence(std::memory_order_release);
+        memcpy(&_value, &value, sizeof(T));
+        _sequence.store(sequence + 2, std::memory_order_release);
+    }
+
+    // consumer: copy the latest value, if there is one that hasn't been fetched yet
+    bool fetch(T *value) {
+        uint32_t sequence;
+        while (true) {
+            sequence = _sequence.load(std::memory_order_acquire);
+            if (sequence == _fetchedSequence) {
+                return false;
+            }
+            // a post in progress, or one that completed while copying, means the copy may be torn
+            if (!(sequence & 1)) {
+                memcpy(value, &_value, sizeof(T));
+                std::atomic_thread_fence(std::memory_order_acquire);
+                if (_sequence.load(std::memory_order_relaxed) == sequence) {
+                    break;
+                }
+            }
+        }
+
+        _coalesced += (sequence - _fetchedSequence) / 2 - 1;
+        _fetchedSequence = sequence;
+        return true;
+    }
+
+    // number of values that were replaced before they were fetched
+    uint32_t coalesced() const {
+        return _coalesced;
+    }
+
+  private:
+    std::atomic<uint32_t> _sequence{0};
+    T _value;
+
+    // consumer side
+    uint32_t _fetchedSequence = 0;
+    uint32_t _coalesced = 0;
+};
+
+} /* namespace Util */
+
+#endif /* UTIL_MAILBOX_H_ */
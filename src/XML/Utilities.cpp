@@ -1,5 +1,7 @@
 #include <HardwareSerial.h>
-#include <WString.h>
+#include <algorithm>
+#include <cctype>
+#include <cstring>
 #include <functional>
 #include <stddef.h>
 
@@ -7,33 +9,415 @@
 
 namespace XML {
 
-void replaceEntities(String &s) {
-    s.replace(F("&lt;"), F("<"));
-    s.replace(F("&gt;"), F(">"));
-    s.replace(F("&apos;"), F("'"));
-    s.replace(F("&quot;"), F("\""));
-    // TODO replace unicode entities with UTF-8 bytes
-    s.replace(F("&amp;"), F("&"));
+Tag::Tag(const char *data, uint8_t attributeCount) : _data(data), _attributeCount(attributeCount) {
 }
 
-bool extractEncodedTags(Stream &stream, const char *terminator, std::function<bool(String tag)> callback) {
-    return extractEncodedTags<int>(stream, terminator, [&callback](String tag, int) -> bool { return callback(tag); }, 0);
+const char *Tag::name() const {
+    return _data;
 }
 
-bool extractAttributeValue(String tag, String attributeName, String *attributeValue) {
-    int attributeStart = tag.indexOf(' ' + attributeName + "=\"");
-    if (attributeStart < 0) {
-        Serial.println(F("Failed to find start of attribute"));
-        return false;
+const char *Tag::attribute(const char *name) const {
+    // skip the tag name, then walk the name/value pairs
+    const char *p = _data + strlen(_data) + 1;
+    for (uint8_t i = 0; i < _attributeCount; i++) {
+        const char *value = p + strlen(p) + 1;
+        if (!strcmp(p, name)) {
+            return value;
+        }
+        p = value + strlen(value) + 1;
+    }
+    return nullptr;
+}
+
+static bool entityIs(const char *entity, size_t length, const char *name) {
+    return strlen(name) == length && !strncmp(entity, name, length);
+}
+
+// decode the entity name (without '&' and ';') into at most 4 UTF-8 bytes
+// returns the number of bytes, or 0 if the entity is unknown
+static size_t decodeEntity(const char *entity, size_t length, char *out) {
+    if (entityIs(entity, length, "lt")) {
+        *out = '<';
+    } else if (entityIs(entity, length, "gt")) {
+        *out = '>';
+    } else if (entityIs(entity, length, "amp")) {
+        *out = '&';
+    } else if (entityIs(entity, length, "quot")) {
+        *out = '"';
+    } else if (entityIs(entity, length, "apos")) {
+        *out = '\'';
+    } else if (length >= 2 && entity[0] == '#') {
+        // numeric character reference, decimal or hexadecimal
+        bool hex = entity[1] == 'x' || entity[1] == 'X';
+        size_t i = hex ? 2 : 1;
+        if (i == length) {
+            return 0;
+        }
+        uint32_t codePoint = 0;
+        for (; i < length; i++) {
+            char ch = entity[i];
+            uint8_t digit;
+            if (isdigit(ch)) {
+                digit = ch - '0';
+            } else if (hex && isxdigit(ch)) {
+                digit = tolower(ch) - 'a' + 10;
+            } else {
+                return 0;
+            }
+            codePoint = (hex ? 16 : 10) * codePoint + digit;
+            if (codePoint > 0x10FFFF) {
+                return 0;
+            }
+        }
+        if (codePoint == 0) {
+            return 0;
+        } else if (codePoint < 0x80) {
+            out[0] = codePoint;
+            return 1;
+        } else if (codePoint < 0x800) {
+            out[0] = 0xC0 | (codePoint >> 6);
+            out[1] = 0x80 | (codePoint & 0x3F);
+            return 2;
+        } else if (codePoint < 0x10000) {
+            out[0] = 0xE0 | (codePoint >> 12);
+            out[1] = 0x80 | ((codePoint >> 6) & 0x3F);
+            out[2] = 0x80 | (codePoint & 0x3F);
+            return 3;
+        } else {
+            out[0] = 0xF0 | (codePoint >> 18);
+            out[1] = 0x80 | ((codePoint >> 12) & 0x3F);
+            out[2] = 0x80 | ((codePoint >> 6) & 0x3F);
+            out[3] = 0x80 | (codePoint & 0x3F);
+            return 4;
+        }
+    } else {
+        return 0;
+    }
+    return 1;
+}
+
+static bool isEntityChar(char ch) {
+    return isalnum(ch) || ch == '#';
+}
+
+EncodedTagTokenizer::EncodedTagTokenizer(char *buffer, size_t size, const char *terminator) : _buffer(buffer), _size(size), _terminator(terminator) {
+}
+
+void EncodedTagTokenizer::setFilter(const char *const *tagNames, const char *const *attributeNames) {
+    _tagNames = tagNames;
+    _attributeNames = attributeNames;
+}
+
+static bool isListed(const char *name, const char *const *names) {
+    for (; *names; names++) {
+        if (!strcmp(name, *names)) {
+            return true;
+        }
+    }
+    return false;
+}
+
+EncodedTagTokenizer::Result EncodedTagTokenizer::feed(const char *data, size_t length, const TagCallback &callback) {
+    for (size_t i = 0; i < length; i++) {
+        Result result = _state == _S_TEXT ? _processText(data[i]) : _processTag1(data[i], callback);
+        if (result != MORE) {
+            return result;
+        }
+    }
+    return MORE;
+}
+
+EncodedTagTokenizer::Result EncodedTagTokenizer::_processText(char ch) {
+    static const char START[] = "&lt;";
+
+    // continuously match the start marker of the next tag; neither marker repeats its first character,
+    // so restarting the match at the current character is sufficient
+    if (ch == START[_startMatched]) {
+        if (!START[++_startMatched]) {
+            _startMatched = 0;
+            _terminatorMatched = 0;
+            _length = 0;
+            _attributeCount = 0;
+            _dropValue = false;
+            _inEntity1 = false;
+            _inEntity2 = false;
+            _state = _S_NAME;
+            return MORE;
+        }
+    } else {
+        _startMatched = ch == START[0] ? 1 : 0;
+    }
+
+    // continuously match the terminator
+    if (ch == _terminator[_terminatorMatched]) {
+        if (!_terminator[++_terminatorMatched]) {
+            return DONE;
+        }
+    } else {
+        _terminatorMatched = ch == _terminator[0] ? 1 : 0;
+    }
+
+    return MORE;
+}
+
+EncodedTagTokenizer::Result EncodedTagTokenizer::_processTag1(char ch, const TagCallback &callback) {
+    if (_inEntity1) {
+        if (ch == ';') {
+            _inEntity1 = false;
+            char decoded[4];
+            size_t decodedLength = decodeEntity(_entity1, _entity1Length, decoded);
+            if (decodedLength == 1 && decoded[0] == '>') {
+                // an encoded '>' always ends the tag; a literal '>' would be encoded twice
+                return _completeTag(callback);
+            }
+            if (decodedLength) {
+                for (size_t i = 0; i < decodedLength; i++) {
+                    _processTag2(decoded[i]);
+                }
+            } else {
+                // unknown entity, pass it on verbatim
+                _processTag2('&');
+                for (size_t i = 0; i < _entity1Length; i++) {
+                    _processTag2(_entity1[i]);
+                }
+                _processTag2(';');
+            }
+            return MORE;
+        }
+        if (isEntityChar(ch) && _entity1Length < _ENTITY_SIZE) {
+            _entity1[_entity1Length++] = ch;
+            return MORE;
+        }
+
+        // not an entity after all, pass it on verbatim and continue with the current character
+        _inEntity1 = false;
+        _processTag2('&');
+        for (size_t i = 0; i < _entity1Length; i++) {
+            _processTag2(_entity1[i]);
+        }
+    }
+
+    if (ch == '&') {
+        _inEntity1 = true;
+        _entity1Length = 0;
+    } else {
+        _processTag2(ch);
+    }
+    return MORE;
+}
+
+EncodedTagTokenizer::Result EncodedTagTokenizer::_completeTag(const TagCallback &callback) {
+    if (_state == _S_NAME) {
+        // tag without attributes
+        _processStructure(' ');
     }
-    int valueStart = attributeStart + attributeName.length() + 3;
-    int valueEnd = tag.indexOf('"', valueStart);
-    if (valueEnd < 0) {
-        Serial.println(F("Failed to find end of attribute"));
+
+    bool complete = _state == _S_ATTRIBUTE_SPACE;
+    _state = _S_TEXT;
+
+    if (complete && !callback(Tag(_buffer, _attributeCount))) {
+        return ABORTED;
+    }
+    return MORE;
+}
+
+void EncodedTagTokenizer::_processTag2(char ch) {
+    // entities of the inner encoding are only meaningful in attribute values
+    if (_state == _S_ATTRIBUTE_VALUE) {
+        if (_inEntity2) {
+            if (ch == ';') {
+                _inEntity2 = false;
+                char decoded[4];
+                size_t decodedLength = decodeEntity(_entity2, _entity2Length, decoded);
+                if (decodedLength) {
+                    // decoded characters are literal, even if they are quotes
+                    for (size_t i = 0; i < decodedLength; i++) {
+                        _append(decoded[i]);
+                    }
+                } else {
+                    _append('&');
+                    for (size_t i = 0; i < _entity2Length; i++) {
+                        _append(_entity2[i]);
+                    }
+                    _append(';');
+                }
+                return;
+            }
+            if (isEntityChar(ch) && _entity2Length < _ENTITY_SIZE) {
+                _entity2[_entity2Length++] = ch;
+                return;
+            }
+
+            // not an entity after all, pass it on verbatim and continue with the current character
+            _inEntity2 = false;
+            _append('&');
+            for (size_t i = 0; i < _entity2Length; i++) {
+                _append(_entity2[i]);
+            }
+        }
+
+        if (ch == '&') {
+            _inEntity2 = true;
+            _entity2Length = 0;
+            return;
+        }
+    }
+
+    _processStructure(ch);
+}
+
+void EncodedTagTokenizer::_processStructure(char ch) {
+    switch (_state) {
+    case _S_NAME:
+        if (isspace(ch) || (ch == '/' && _length)) {
+            _append('\0');
+            if (_state == _S_NAME) {
+                // tags that are filtered out are dropped silently
+                _state = !_tagNames || isListed(_buffer, _tagNames) ? _S_ATTRIBUTE_SPACE : _S_SKIP;
+            }
+        } else {
+            _append(ch);
+        }
+        break;
+    case _S_ATTRIBUTE_SPACE:
+        // ignore the end markers of empty-element tags and processing instructions
+        if (!isspace(ch) && ch != '/' && ch != '?') {
+            _attributeStart = _length;
+            _append(ch);
+            _state = _S_ATTRIBUTE_NAME;
+        }
+        break;
+    case _S_ATTRIBUTE_NAME:
+        if (ch == '=') {
+            _endAttributeName();
+            _state = _S_ATTRIBUTE_QUOTE;
+        } else if (isspace(ch)) {
+            _endAttributeName();
+            _state = _S_ATTRIBUTE_EQUALS;
+        } else {
+            _append(ch);
+        }
+        break;
+    case _S_ATTRIBUTE_EQUALS:
+        if (ch == '=') {
+            _state = _S_ATTRIBUTE_QUOTE;
+        } else if (!isspace(ch)) {
+            _skip();
+        }
+        break;
+    case _S_ATTRIBUTE_QUOTE:
+        if (ch == '"' || ch == '\'') {
+            _quote = ch;
+            _state = _S_ATTRIBUTE_VALUE;
+        } else if (!isspace(ch)) {
+            _skip();
+        }
+        break;
+    case _S_ATTRIBUTE_VALUE:
+        if (ch == _quote && _dropValue) {
+            _dropValue = false;
+            _state = _S_ATTRIBUTE_SPACE;
+        } else if (ch == _quote) {
+            _append('\0');
+            if (_attributeCount == UINT8_MAX) {
+                _skip();
+            } else if (_state == _S_ATTRIBUTE_VALUE) {
+                _attributeCount++;
+                _state = _S_ATTRIBUTE_SPACE;
+            }
+        } else {
+            _append(ch);
+        }
+        break;
+    case _S_TEXT:
+    case _S_SKIP:
+        break;
+    }
+}
+
+void EncodedTagTokenizer::_endAttributeName() {
+    _append('\0');
+    if (_state != _S_SKIP && _attributeNames && !isListed(_buffer + _attributeStart, _attributeNames)) {
+        // forget the name and drop the value
+        _length = _attributeStart;
+        _dropValue = true;
+    }
+}
+
+void EncodedTagTokenizer::_append(char ch) {
+    if (_state == _S_SKIP || _dropValue) {
+        return;
+    }
+    if (_length < _size) {
+        _buffer[_length++] = ch;
+    } else {
+        _skip();
+    }
+}
+
+void EncodedTagTokenizer::_skip() {
+    if (_state != _S_SKIP) {
+        Serial.println(F("Skipping malformed or oversized tag"));
+        _state = _S_SKIP;
+    }
+}
+
+bool extractEncodedTags(Stream &stream, const char *terminator, char *buffer, size_t size, TagCallback callback) {
+    EncodedTagTokenizer tokenizer(buffer, size, terminator);
+    return extractEncodedTags(stream, tokenizer, callback);
+}
+
+bool extractEncodedTags(Stream &stream, EncodedTagTokenizer &tokenizer, const TagCallback &callback) {
+    char chunk[64];
+    while (true) {
+        // read whatever is available, but at least one byte (using a timed read)
+        int available = stream.available();
+        size_t length = stream.readBytes(chunk, available > 1 ? std::min(static_cast<size_t>(available), sizeof(chunk)) : 1);
+        if (!length) {
+            Serial.println(F("Stream ended unexpectedly"));
+            return false;
+        }
+
+        switch (tokenizer.feed(chunk, length, callback)) {
+        case EncodedTagTokenizer::DONE:
+            return true;
+        case EncodedTagTokenizer::ABORTED:
+            Serial.println(F("Callback returned false"));
+            return false;
+        case EncodedTagTokenizer::MORE:
+            break;
+        }
+    }
+}
+
+EncodedTagTokenizer::Result feedAvailableEncodedTags(Stream &stream, EncodedTagTokenizer &tokenizer, const TagCallback &callback, size_t maxLength) {
+    char chunk[64];
+    while (maxLength) {
+        int available = stream.available();
+        if (available <= 0) {
+            break;
+        }
+        size_t length = stream.readBytes(chunk, std::min({static_cast<size_t>(available), sizeof(chunk), maxLength}));
+        if (!length) {
+            break;
+        }
+        maxLength -= length;
+
+        EncodedTagTokenizer::Result result = tokenizer.feed(chunk, length, callback);
+        if (result != EncodedTagTokenizer::MORE) {
+            return result;
+        }
+    }
+    return EncodedTagTokenizer::MORE;
+}
+
+bool extractAttributeValue(const Tag &tag, const char *attributeName, const char **attributeValue) {
+    const char *value = tag.attribute(attributeName);
+    if (!value) {
+        Serial.print(F("Failed to find attribute "));
+        Serial.println(attributeName);
         return false;
     }
-    String value = tag.substring(valueStart, valueEnd);
-    replaceEntities(value);
     *attributeValue = value;
     return true;
 }
@@ -1,59 +1,129 @@
 #ifndef XML_UTILITIES_H_
 #define XML_UTILITIES_H_
 
-#include <HardwareSerial.h>
-#include <WString.h>
+#include <Stream.h>
+#include <cstdint>
 #include <functional>
 #include <stddef.h>
 
 namespace XML {
 
-void replaceEntities(String &s);
-bool extractEncodedTags(Stream &stream, const char *terminator, std::function<bool(String tag)> callback);
-bool extractAttributeValue(String tag, String attributeName, String *attributeValue);
-
-template <typename T> bool extractEncodedTags(Stream &stream, const char *terminator, std::function<bool(String tag, T userInfo)> callback, T userInfo) {
-    // skip everything up to (and including) the next &lt;
-    while (stream.findUntil("&lt;", terminator)) {
-        String tag = "&lt;";
-
-        // find the next &gt; that ends the encoded tag
-        const char *endMarker = "&gt;";
-        size_t i = 0;
-        while (true) {
-            char endMarkerCh = endMarker[i];
-            if (!endMarkerCh) {
-                // tag is complete, replace the XML entities
-                replaceEntities(tag);
-                if (!callback(tag, userInfo)) {
-                    Serial.println(F("Callback returned false"));
-                    return false;
-                }
-                break;
-            }
-
-            // use stream.readBytes() to do a timed read
-            char ch;
-            int cnt = stream.readBytes(&ch, 1);
-            if (!cnt) {
-                Serial.println(F("Stream ended unexpectedly"));
-                return false;
-            }
-
-            // continuously match endMarker
-            if (ch == endMarkerCh) {
-                i++;
-            } else {
-                // reset after failed match
-                i = 0;
-            }
-
-            // append read character
-            tag += ch;
-        }
-    }
-
-    return true;
+// non-owning view of a decoded tag
+// only valid while the tag callback is running, because it points into the tokenizer's buffer
+class Tag {
+  public:
+    Tag(const char *data, uint8_t attributeCount);
+
+    // tag name, including a leading '/' for closing tags
+    const char *name() const;
+
+    // decoded attribute value, nullptr if the tag doesn't have the attribute
+    const char *attribute(const char *name) const;
+
+  private:
+    const char *_data;
+    uint8_t _attributeCount;
+};
+
+typedef std::function<bool(const Tag &tag)> TagCallback;
+
+// incremental tokenizer for XML-encoded XML, e.g. &lt;Volume channel=&quot;Master&quot; val=&quot;12&quot;/&gt;
+// entities are decoded inline on both encoding levels, without any heap allocations
+// decoded tags are assembled in the caller-supplied buffer as "name\0attr1\0value1\0attr2\0value2\0..."
+class EncodedTagTokenizer {
+  public:
+    enum Result {
+        // all data has been consumed, feed more
+        MORE,
+        // the terminator has been found
+        DONE,
+        // the callback returned false
+        ABORTED,
+    };
+
+    // terminator is the (unencoded) text that ends the encoded section, e.g. "</LastChange>"
+    EncodedTagTokenizer(char *buffer, size_t size, const char *terminator);
+
+    // only report tags with one of the given names, and only keep the given attributes (both nullptr-terminated lists)
+    // everything else is dropped while decoding, so the buffer only has to hold what the caller is interested in
+    // either list may be nullptr to disable that filter
+    void setFilter(const char *const *tagNames, const char *const *attributeNames);
+
+    // process the next chunk of data, invoking the callback for every complete tag
+    // after DONE or ABORTED, the tokenizer must not be fed any more
+    Result feed(const char *data, size_t length, const TagCallback &callback);
+
+  private:
+    enum _State {
+        _S_TEXT,
+        _S_NAME,
+        _S_ATTRIBUTE_SPACE,
+        _S_ATTRIBUTE_NAME,
+        _S_ATTRIBUTE_EQUALS,
+        _S_ATTRIBUTE_QUOTE,
+        _S_ATTRIBUTE_VALUE,
+        _S_SKIP,
+    };
+
+    // maximum length of an entity name, e.g. "quot" or "#x10FFFF"
+    static const size_t _ENTITY_SIZE = 8;
+
+    char *_buffer;
+    size_t _size;
+    const char *_terminator;
+    const char *const *_tagNames = nullptr;
+    const char *const *_attributeNames = nullptr;
+
+    _State _state = _S_TEXT;
+    size_t _length = 0;
+    uint8_t _attributeCount = 0;
+    char _quote = 0;
+
+    // start of the current attribute in the buffer, and whether its value is dropped by the filter
+    size_t _attributeStart = 0;
+    bool _dropValue = false;
+
+    // progress matching "&lt;" and the terminator outside of tags
+    size_t _startMatched = 0;
+    size_t _terminatorMatched = 0;
+
+    // pending entity of the outer (level 1) and inner (level 2) encoding
+    bool _inEntity1 = false;
+    char _entity1[_ENTITY_SIZE];
+    size_t _entity1Length = 0;
+    bool _inEntity2 = false;
+    char _entity2[_ENTITY_SIZE];
+    size_t _entity2Length = 0;
+
+    Result _processText(char ch);
+    Result _processTag1(char ch, const TagCallback &callback);
+    Result _completeTag(const TagCallback &callback);
+    void _processTag2(char ch);
+    void _processStructure(char ch);
+    void _endAttributeName();
+    void _append(char ch);
+    void _skip();
+};
+
+// extract the encoded tags from the stream, up to the (unencoded) terminator
+// the stream is read in chunks; tags larger than the buffer are skipped
+// if the callback returns false, extraction is aborted and false is returned
+bool extractEncodedTags(Stream &stream, const char *terminator, char *buffer, size_t size, TagCallback callback);
+
+// same as above, using a tokenizer set up by the caller
+bool extractEncodedTags(Stream &stream, EncodedTagTokenizer &tokenizer, const TagCallback &callback);
+
+// feed the tokenizer with the data that is already available in the stream, without waiting for more
+// at most maxLength bytes are consumed, which bounds the time spent in a single call
+EncodedTagTokenizer::Result feedAvailableEncodedTags(Stream &stream, EncodedTagTokenizer &tokenizer, const TagCallback &callback, size_t maxLength = 512);
+
+// extract the attribute value from the tag, logging a message if it is missing
+bool extractAttributeValue(const Tag &tag, const char *attributeName, const char **attributeValue);
+
+template <typename T>
+bool extractEncodedTags(Stream &stream, const char *terminator, char *buffer, size_t size, std::function<bool(const Tag &tag, T userInfo)> callback,
+                        T userInfo) {
+    return extractEncodedTags(stream, terminator, buffer, size, [&callback, &userInfo](const Tag &tag) -> bool { return callback(tag, userInfo); });
 }
 
 } // namespace XML
@@ -1,35 +1,50 @@
 #include <NeoPixelBus.h>
 
 #include <Arduino.h>
+#include <ArduinoJson.h>
 #include <ArduinoOTA.h>
 #include <ESP8266WiFi.h>
 #include <ESP8266WiFiType.h>
 #include <Esp.h>
 #include <HardwareSerial.h>
 #include <IPAddress.h>
-#include <Ticker.h>
 #include <pins_arduino.h>
 
 #include <WString.h>
+#include <algorithm>
 #include <cassert>
 #include <cctype>
 #include <cmath>
 #include <cstdint>
 #include <cstring>
 #include <functional>
+#include <memory>
 #include <stddef.h>
+#include <utility>
+#include <vector>
 
 #include "Color/ColorCycle.h"
+#include "Color/FixedPoint.h"
 #include "Color/Gradient.h"
+#include "Color/Pattern.h"
 #include "Color/RGB.h"
 #include "Config/LedConfig.h"
 #include "Config/NetworkConfig.h"
 #include "Config/PersistentConfig.h"
 #include "Config/Server.h"
 #include "Config/SonosConfig.h"
+#include "HTTP/ConnectionPool.h"
 #include "Sonos/Discover.h"
+#include "Sonos/RenderingControl.h"
+#include "Sonos/RenderingControlEvent.h"
+#include "Sonos/RoomDirectory.h"
+#include "Sonos/ZoneGroupState.h"
 #include "Sonos/ZoneGroupTopology.h"
+#include "Timing/Backoff.h"
+#include "Timing/Easing.h"
+#include "Timing/FrameScheduler.h"
 #include "UPnP/EventServer.h"
+#include "Util/Mailbox.h"
 #include "XML/Utilities.h"
 
 const String AP_SSID = String("svd-") + String(ESP.getChipId(), 16);
@@ -38,10 +53,9 @@ const uint16_t LED_COUNT = 24;
 const uint8_t LED_PIN = D1;
 
 Config::PersistentConfig config;
-Config::Server configServer(config);
+Sonos::RoomDirectory roomDirectory;
+Config::Server configServer(config, roomDirectory);
 std::unique_ptr<UPnP::EventServer> eventServer;
-Color::Gradient gradient;
-
 NeoGamma<NeoGammaTableMethod> colorGamma;
 
 NeoPixelBus<NeoGrbFeature, NeoEsp8266BitBang800KbpsMethod> strip(LED_COUNT, LED_PIN);
@@ -52,22 +66,13 @@ WiFiEventHandler sta_disconnected;
 // color for mute
 const RgbColor MUTE_COLOR(0, 0, 63);
 
+// color for missing WiFi connection
+const RgbColor NOT_CONNECTED_COLOR(63, 0, 0);
+
 // rainbow cycle for startup animation
 const uint16_t COLOR_CYCLE_LENGTH = 57;
 const Color::ColorCycle COLOR_CYCLE(COLOR_CYCLE_LENGTH, 0, COLOR_CYCLE_LENGTH / 3, 2 * COLOR_CYCLE_LENGTH / 3);
 
-struct VolumeState {
-    int8_t master = -1, lf = -1, rf = -1, mute = -1;
-
-    bool isComplete() const {
-        return master != -1 && lf != -1 && rf != -1 && mute != -1;
-    }
-
-    bool operator!=(const VolumeState &other) const {
-        return master != other.master || lf != other.lf || rf != other.rf || mute != other.mute;
-    }
-};
-
 class Display {
   public:
     void notifyNotReady() {
@@ -86,23 +91,41 @@ class Display {
     void notifyReady() {
         if (_state == _DS_COLOR_CYCLE) {
             // reset volume state
-            _volumeState = VolumeState();
+            _volumeState = Sonos::VolumeState();
+            _leftLevel.set(0);
+            _rightLevel.set(0);
 
             _state = _DS_NOTHING;
         }
     }
 
+    // the LED configuration has changed, rebuild everything derived from it
+    void notifyConfigChanged() {
+        _baked = false;
+    }
+
+    // switch all LEDs off, e.g. while the firmware is updated; the next frame is sent in any case
+    void turnOff() {
+        strip.ClearTo(RgbColor(0));
+        strip.Show();
+        _framePushed = false;
+    }
+
     void notifyNotConnected() {
         _state = _DS_NOT_CONNECTED;
     }
 
-    void notifyVolumeState(const VolumeState &volumeState) {
+    void notifyVolumeState(const Sonos::VolumeState &volumeState) {
         // check for changes
         if (volumeState.isComplete() && volumeState != _volumeState) {
             // copy changes to current state
             _volumeState = volumeState;
 
             Serial.printf_P(PSTR("master=%u, lf=%u, rf=%u, mute=%u\n"), _volumeState.master, _volumeState.lf, _volumeState.rf, _volumeState.mute);
+            // the bars ease towards the latest state, events arriving in between frames just move the target
+            unsigned long now = millis();
+            _leftLevel.setTarget(_level(_volumeState.master, _volumeState.lf), now);
+            _rightLevel.setTarget(_level(_volumeState.master, _volumeState.rf), now);
             _state = _DS_VOLUME_STATE;
             if (!_volumeState.mute) {
                 _volumeShownAtMillis = millis();
@@ -110,66 +133,108 @@ class Display {
         }
     }
 
-    void updateDisplay(std::function<float(float)> transform) {
+    // bake the pattern for the volume display; it is only evaluated again when this is called
+    void setPattern(const Color::Pattern &pattern) {
+        pattern.bake(_pattern, LED_COUNT);
+        _baked = false;
+    }
+
+    // compose the next frame and send it to the strip if it changed
+    // frames is the number of frame periods the animation has to advance
+    void updateDisplay(std::function<uint32_t(uint32_t)> transform, uint8_t frames = 1) {
+        // brightness and gamma are folded into the tables, so they only have to be rebuilt when the brightness changes
+        uint8_t brightness = config.led().brightness();
+        if (!_baked || brightness != _brightness) {
+            _bake(brightness);
+        }
+
         if (_state == _DS_VOLUME_STATE && !_volumeState.mute && millis() > _volumeShownAtMillis + 2000) {
             _state = _DS_NOTHING;
         }
 
         if (_state == _DS_COLOR_CYCLE) {
-            // update LEDs
-            for (int i = 0; i < LED_COUNT; i++) {
-                _leds[i] = RgbColor::LinearBlend(_leds[i], 0, 20.0f / 255.0f);
+            for (uint8_t frame = 0; frame < frames; frame++) {
+                // update LEDs
+                for (int i = 0; i < LED_COUNT; i++) {
+                    _leds[i] = _fade(_leds[i]);
+                }
+                _leds[_colorCycleLedOffset] = _toRgbColor(COLOR_CYCLE.get(_colorCycleOffset));
+
+                // update offsets
+                if (++_colorCycleLedOffset == LED_COUNT) {
+                    _colorCycleLedOffset = 0;
+                }
+                if (++_colorCycleOffset == COLOR_CYCLE_LENGTH) {
+                    _colorCycleOffset = 0;
+                }
             }
-            _leds[_colorCycleLedOffset] = _toRgbColor(COLOR_CYCLE.get(_colorCycleOffset));
 
-            // update offsets
-            if (++_colorCycleLedOffset == LED_COUNT) {
-                _colorCycleLedOffset = 0;
-            }
-            if (++_colorCycleOffset == COLOR_CYCLE_LENGTH) {
-                _colorCycleOffset = 0;
-            }
-        } else if (_state == _DS_VOLUME_STATE) {
             for (int i = 0; i < LED_COUNT; i++) {
-                _leds[i] = RgbColor(0, 0, 0);
+                _frame[i] = _correct(_leds[i]);
             }
-
-            float leftLed = LED_COUNT / 2 * transform(_volumeState.master * _volumeState.lf / 10000.0);
-            uint16_t leftLedInt = floor(leftLed);
-            float leftLedFrac = leftLed - leftLedInt;
-            for (uint16_t i = 0; i < leftLedInt; i++) {
-                _leds[i] = _volumeState.mute ? MUTE_COLOR : _toRgbColor(gradient.get(i));
+        } else if (_state == _DS_VOLUME_STATE) {
+            std::fill(_frame, _frame + LED_COUNT, RgbColor(0));
+
+            // eased by elapsed time, so the speed doesn't depend on the frame rate or on skipped frames
+            unsigned long now = millis();
+            // bar length in LEDs, Q16
+            uint32_t leftLed = LED_COUNT / 2 * transform(_leftLevel.update(now));
+            uint16_t leftLedInt = leftLed >> 16;
+            uint8_t leftLedFrac = leftLed >> 8;
+            if (_volumeState.mute) {
+                std::fill(_frame, _frame + leftLedInt, _muteFrameColor);
+            } else {
+                std::copy(_volumeFrame, _volumeFrame + leftLedInt, _frame);
             }
             if (leftLedInt < LED_COUNT / 2) {
-                _leds[leftLedInt] = RgbColor::LinearBlend(0, _volumeState.mute ? MUTE_COLOR : _toRgbColor(gradient.get(leftLedInt)), leftLedFrac);
+                _frame[leftLedInt] = _correct(_scale(_volumeState.mute ? MUTE_COLOR : _toRgbColor(_pattern[leftLedInt]), leftLedFrac));
             }
 
-            float rightLed = LED_COUNT / 2 * transform(_volumeState.master * _volumeState.rf / 10000.0);
-            uint16_t rightLedInt = floor(rightLed);
-            float rightLedFrac = rightLed - rightLedInt;
-            for (uint16_t i = 0; i < rightLedInt; i++) {
-                _leds[LED_COUNT - 1 - i] = _volumeState.mute ? MUTE_COLOR : _toRgbColor(gradient.get(LED_COUNT - 1 - i));
+            uint32_t rightLed = LED_COUNT / 2 * transform(_rightLevel.update(now));
+            uint16_t rightLedInt = rightLed >> 16;
+            uint8_t rightLedFrac = rightLed >> 8;
+            if (_volumeState.mute) {
+                std::fill(_frame + LED_COUNT - rightLedInt, _frame + LED_COUNT, _muteFrameColor);
+            } else {
+                std::copy(_volumeFrame + LED_COUNT - rightLedInt, _volumeFrame + LED_COUNT, _frame + LED_COUNT - rightLedInt);
             }
             if (rightLedInt < LED_COUNT / 2) {
-                _leds[LED_COUNT - 1 - rightLedInt] =
-                    RgbColor::LinearBlend(0, _volumeState.mute ? MUTE_COLOR : _toRgbColor(gradient.get(LED_COUNT - 1 - rightLedInt)), rightLedFrac);
+                uint16_t i = LED_COUNT - 1 - rightLedInt;
+                _frame[i] = _correct(_scale(_volumeState.mute ? MUTE_COLOR : _toRgbColor(_pattern[i]), rightLedFrac));
             }
         } else if (_state == _DS_NOTHING) {
-            for (int i = 0; i < LED_COUNT; i++) {
-                _leds[i] = RgbColor(0, 0, 0);
-            }
+            std::fill(_frame, _frame + LED_COUNT, RgbColor(0));
         } else if (_state == _DS_NOT_CONNECTED) {
-            for (int i = 0; i < LED_COUNT; i++) {
-                _leds[i] = RgbColor(63, 0, 0);
-            }
+            std::fill(_frame, _frame + LED_COUNT, _notConnectedFrameColor);
+        }
+
+        _framesComputed++;
+
+        // only push the frame if it differs from the one that was sent last
+        // showing disables interrupts for the whole transmission, which hurts the WiFi stack
+        if (_framePushed && std::equal(_frame, _frame + LED_COUNT, _pushedFrame)) {
+            return;
         }
 
-        const Config::LedConfig &ledConfig = config.led();
         for (int i = 0; i < LED_COUNT; i++) {
-            strip.SetPixelColor(i, colorGamma.Correct(RgbColor::LinearBlend(0, _leds[i], ledConfig.brightness() / 255.0f)));
+            strip.SetPixelColor(i, _frame[i]);
         }
 
         strip.Show();
+
+        std::copy(_frame, _frame + LED_COUNT, _pushedFrame);
+        _framePushed = true;
+        _framesPushed++;
+    }
+
+    // number of frames composed by updateDisplay()
+    uint32_t framesComputed() const {
+        return _framesComputed;
+    }
+
+    // number of frames actually sent to the strip
+    uint32_t framesPushed() const {
+        return _framesPushed;
     }
 
   private:
@@ -181,98 +246,132 @@ class Display {
     };
     _DisplayState _state = _DS_COLOR_CYCLE;
 
-    VolumeState _volumeState;
+    Sonos::VolumeState _volumeState;
+
+    // displayed volume of the channels, Q16 in the range of 0.0 to 1.0
+    Timing::Easing _leftLevel;
+    Timing::Easing _rightLevel;
 
     unsigned long _volumeShownAtMillis;
 
     int16_t _colorCycleLedOffset = 0;
     int16_t _colorCycleOffset = 0;
 
+    // channel volume relative to the master volume, both in percent
+    static inline int32_t _level(int8_t master, int8_t channel) {
+        return static_cast<int32_t>(master) * channel * 65536 / 10000;
+    }
+
+    // blend from black, like LinearBlend(0, color, fraction / 256.0f), but without soft-float math
+    static inline RgbColor _scale(const RgbColor &color, uint8_t fraction) {
+        return RgbColor(Color::scale8(color.R, fraction), Color::scale8(color.G, fraction), Color::scale8(color.B, fraction));
+    }
+
+    // fade towards black by 20/255, like LinearBlend(color, 0, 20.0f / 255.0f)
+    static inline RgbColor _fade(const RgbColor &color) {
+        return RgbColor(color.R * 235 / 255, color.G * 235 / 255, color.B * 235 / 255);
+    }
+
     inline RgbColor _toRgbColor(const Color::RGB &color) {
         return RgbColor(color.red, color.green, color.blue);
     }
 
+    // apply brightness and gamma correction to a color
+    inline RgbColor _correct(const RgbColor &color) {
+        return RgbColor(_channel[color.R], _channel[color.G], _channel[color.B]);
+    }
+
+    void _bake(uint8_t brightness) {
+        // same result as scaling with LinearBlend and correcting with NeoGamma, for every channel value
+        for (int value = 0; value < 256; value++) {
+            _channel[value] = colorGamma.Correct(RgbColor::LinearBlend(0, RgbColor(static_cast<uint8_t>(value)), brightness / 255.0f)).R;
+        }
+        for (int i = 0; i < LED_COUNT; i++) {
+            _volumeFrame[i] = _correct(_toRgbColor(_pattern[i]));
+        }
+        _muteFrameColor = _correct(MUTE_COLOR);
+        _notConnectedFrameColor = _correct(NOT_CONNECTED_COLOR);
+
+        _brightness = brightness;
+        _baked = true;
+    }
+
+    // linear colors of the color cycle, before brightness and gamma correction
     RgbColor _leds[LED_COUNT];
+
+    // baked volume pattern, before brightness and gamma correction (needed for blending the edge LEDs)
+    Color::RGB _pattern[LED_COUNT];
+
+    // brightness and gamma correction per channel value, and the tables/colors derived from it
+    bool _baked = false;
+    uint8_t _brightness;
+    uint8_t _channel[256];
+    RgbColor _volumeFrame[LED_COUNT];
+    RgbColor _muteFrameColor;
+    RgbColor _notConnectedFrameColor;
+
+    // composed frame, ready to be sent to the strip
+    RgbColor _frame[LED_COUNT];
+
+    // frame that was sent to the strip last
+    bool _framePushed = false;
+    RgbColor _pushedFrame[LED_COUNT];
+
+    uint32_t _framesComputed = 0;
+    uint32_t _framesPushed = 0;
 };
 
 Display display;
 
-Ticker displayUpdateTicker;
-
-bool renderingControlEventXmlTagCallback(String tag, VolumeState &volumeState) {
-    if (tag.startsWith("<Volume ")) {
-        String channel;
-        if (!XML::extractAttributeValue(tag, F("channel"), &channel)) {
-            Serial.println(F("Failed to extract channel attribute from tag"));
-            return false;
-        };
-
-        String val;
-        if (!XML::extractAttributeValue(tag, F("val"), &val)) {
-            Serial.println(F("Failed to extract val attribute from tag"));
-            return false;
-        };
-
-        uint16_t volume = 0;
-        for (const char *p = val.c_str(); *p; p++) {
-            if (isdigit(*p)) {
-                volume = 10 * volume + (*p - '0');
-            } else {
-                Serial.println(F("Found a non-digit in val"));
-                return false;
-            }
-            if (volume > 100) {
-                Serial.println(F("Too large val"));
-                return false;
-            }
-        }
+// frames are rendered from loop(), so they never interrupt network I/O
+// missed frames are caught up by advancing the animation, but only a single frame is sent to the strip
+const unsigned long FRAME_PERIOD_MICROS = 40000;
+Timing::FrameScheduler frameScheduler(FRAME_PERIOD_MICROS, Timing::FrameScheduler::CATCH_UP, 5);
 
-        if (channel == "Master") {
-            volumeState.master = volume;
-        } else if (channel == "LF") {
-            volumeState.lf = volume;
-        } else if (channel == "RF") {
-            volumeState.rf = volume;
-        }
-    } else if (tag.startsWith("<Mute ")) {
-        String channel;
-        if (!XML::extractAttributeValue(tag, F("channel"), &channel)) {
-            Serial.println(F("Failed to extract channel attribute from tag"));
-            return false;
-        };
-
-        if (channel != "Master") {
-            /* only Master channel is muted */
-            return true;
-        }
+// latest volume state, handed from the event handler to the renderer
+// a burst of events between two frames results in a single display update
+Util::Mailbox<Sonos::VolumeState> volumeMailbox;
 
-        String val;
-        if (!XML::extractAttributeValue(tag, F("val"), &val)) {
-            Serial.println(F("Failed to extract val attribute from tag"));
-            return false;
-        };
+// show the volume right after subscribing; the initial event can take seconds to arrive on a slow network
+// the snapshot is fetched in the background, so a slow player doesn't stall rendering
+std::unique_ptr<Sonos::RenderingControl> volumeSnapshot;
 
-        if (val == "0") {
-            volumeState.mute = 0;
-        } else if (val == "1") {
-            volumeState.mute = 1;
-        } else {
-            Serial.println(F("Invalid boolean val"));
-            return false;
-        }
+// volume state from the latest event; fields that are not part of an event keep their previous values
+Sonos::VolumeState eventVolumeState;
+
+// the event is parsed into a copy, which only replaces the volume state once the whole event has arrived
+class VolumeEventParser : public UPnP::EventParser {
+  public:
+    VolumeEventParser() : _volumeState(eventVolumeState), _parser(_volumeState) {
     }
 
-    return true;
-}
+    bool feed(Stream &stream) override {
+        _result = _parser.parseAvailable(stream);
+        return _result == XML::EncodedTagTokenizer::MORE;
+    }
+
+    void end() override {
+        if (_result != XML::EncodedTagTokenizer::DONE) {
+            Serial.println(F("Failed to parse RenderingControl event"));
+            return;
+        }
+        eventVolumeState = _volumeState;
+
+        // the event is newer than a snapshot still on its way
+        volumeSnapshot.reset();
 
-void renderingControlEventCallback(String SID, Stream &stream) {
-    static VolumeState volumeState;
+        // hand over to the display, which picks it up with the next frame
+        volumeMailbox.post(eventVolumeState);
+    }
 
-    // update volume state
-    XML::extractEncodedTags<VolumeState &>(stream, "</LastChange>", &renderingControlEventXmlTagCallback, volumeState);
+  private:
+    Sonos::VolumeState _volumeState;
+    Sonos::RenderingControlEventParser _parser;
+    XML::EncodedTagTokenizer::Result _result = XML::EncodedTagTokenizer::MORE;
+};
 
-    // update display
-    display.notifyVolumeState(volumeState);
+std::unique_ptr<UPnP::EventParser> renderingControlEventCallback(const String &SID) {
+    return std::unique_ptr<UPnP::EventParser>(new VolumeEventParser());
 }
 
 bool startWiFiStation() {
@@ -299,46 +398,153 @@ void startEventServer() {
     Serial.println(WiFi.macAddress());
     eventServer.reset(new UPnP::EventServer(WiFi.localIP()));
     eventServer->begin();
+    Sonos::presence.begin();
 }
 
 IPAddress anySonosDeviceIp;
 
-bool findSonosDeviceIp() {
+// resumable search for any Sonos device, advanced a slice at a time from loop()
+Sonos::Discover sonosDiscover;
+
+// displays powered up together must not search in lockstep, so failed searches are retried after a jittered, growing delay
+Timing::Backoff sonosDiscoverBackoff(2000, 120000);
+uint32_t sonosDiscoverSearches = 0;
+
+bool beginFindSonosDeviceIp() {
     const Config::SonosConfig &sonosConfig = config.sonos();
-    if (sonosConfig.active() && Sonos::Discover::any(&anySonosDeviceIp)) {
+    if (!sonosConfig.active()) {
+        return false;
+    }
+    // an announcement received in the meantime is used right away, as it doesn't cause any traffic
+    unsigned long now = millis();
+    if (!sonosDiscoverBackoff.ready(now) && !Sonos::presence.cache().any(nullptr, now)) {
+        return false;
+    }
+    sonosDiscoverSearches++;
+    if (!sonosDiscover.begin()) {
+        sonosDiscoverBackoff.failed(now);
+        return false;
+    }
+    return true;
+}
+
+bool pollFindSonosDeviceIp() {
+    return sonosDiscover.poll();
+}
+
+bool foundSonosDeviceIp() {
+    if (sonosDiscover.found(&anySonosDeviceIp)) {
         Serial.print(F("Found a device: "));
         Serial.println(anySonosDeviceIp);
+        roomDirectory.setDeviceIP(anySonosDeviceIp);
+        sonosDiscoverBackoff.reset();
         return true;
     }
+    sonosDiscoverBackoff.failed(millis());
+    Serial.print(F("No device found, searching again in "));
+    Serial.print(sonosDiscoverBackoff.delayMillis());
+    Serial.println(F(" ms"));
     return false;
 }
 
+// a player that doesn't respond must not be asked again on every pass, e.g. one unplugged but still in the presence cache
+// it is forgotten and a new search starts after the retry delay
+void sonosDeviceFailed(const IPAddress &deviceIp) {
+    Sonos::presence.cache().remove(deviceIp);
+    sonosDiscoverBackoff.failed(millis());
+    Serial.print(F("Player not usable: "));
+    Serial.print(deviceIp);
+    Serial.print(F(", searching again in "));
+    Serial.print(sonosDiscoverBackoff.delayMillis());
+    Serial.println(F(" ms"));
+}
+
 IPAddress roomSonosDeviceIp;
 
-bool findRoomSonosDeviceIp() {
+// resumable lookup of the configured room's player, advanced a slice at a time from loop()
+std::unique_ptr<Sonos::ZoneGroupTopology> roomLookup;
+
+bool beginFindRoomSonosDeviceIp() {
     const Config::SonosConfig &sonosConfig = config.sonos();
-    if (sonosConfig.active()) {
-        Sonos::ZoneGroupTopology topo(anySonosDeviceIp);
-        bool found = false;
-        topo.GetZoneGroupState_Decoded([sonosConfig, &found](Sonos::ZoneInfo info) {
-            if (info.uuid == sonosConfig.roomUuid()) {
-                Serial.print(F("Found a player with the configured room: "));
-                Serial.print(info.name);
-                Serial.print(F(" @ "));
-                Serial.println(info.playerIP);
-                roomSonosDeviceIp = info.playerIP;
-                found = true;
-            }
-        });
+    if (!sonosConfig.active()) {
+        return false;
+    }
 
-        if (found) {
-            return true;
-        }
+    roomLookup.reset(new Sonos::ZoneGroupTopology(anySonosDeviceIp));
+    return roomLookup->beginFindPlayer(sonosConfig.roomUuid(), &roomSonosDeviceIp);
+}
+
+// returns PENDING while the lookup is running; DONE only if the room has been found
+Sonos::ZoneGroupTopology::Result pollFindRoomSonosDeviceIp() {
+    Sonos::ZoneGroupTopology::Result result = roomLookup->poll();
+    if (result == Sonos::ZoneGroupTopology::PENDING) {
+        return result;
+    }
+    bool found = roomLookup->found();
+    roomLookup.reset();
+    if (result == Sonos::ZoneGroupTopology::DONE && !found) {
         Serial.println(F("Failed to find the configured room"));
+        return Sonos::ZoneGroupTopology::FAILED;
+    }
+    if (found) {
+        Serial.print(F("Found a player with the configured room @ "));
+        Serial.println(roomSonosDeviceIp);
+    }
+    return result;
+}
+
+// set while subscribed to the cached player of the room, until a topology lookup has confirmed it
+bool roomSonosDeviceIpFromCache = false;
+
+bool useCachedRoomSonosDeviceIp() {
+    const Config::SonosConfig &sonosConfig = config.sonos();
+    if (sonosConfig.active() && config.playerCache().lookup(sonosConfig.roomUuid(), &roomSonosDeviceIp)) {
+        Serial.print(F("Using cached player of the configured room: "));
+        Serial.println(roomSonosDeviceIp);
+        return true;
     }
     return false;
 }
 
+// only written when the player actually changes, to save flash wear
+void cacheRoomSonosDeviceIp() {
+    Config::PlayerCache playerCache = config.playerCache();
+    const char *roomUuid = config.sonos().roomUuid();
+    IPAddress cachedIp;
+    if (!playerCache.lookup(roomUuid, &cachedIp) || cachedIp != roomSonosDeviceIp) {
+        playerCache.set(roomUuid, roomSonosDeviceIp);
+        config.saveCache();
+    }
+}
+
+void endNetworkLookups() {
+    sonosDiscover.end();
+    roomLookup.reset();
+    volumeSnapshot.reset();
+}
+
+void beginVolumeSnapshot() {
+    volumeSnapshot.reset(new Sonos::RenderingControl(roomSonosDeviceIp));
+    if (!volumeSnapshot->beginGetVolumeState()) {
+        volumeSnapshot.reset();
+    }
+}
+
+void pollVolumeSnapshot() {
+    switch (volumeSnapshot->poll()) {
+    case Sonos::RenderingControl::PENDING:
+        return;
+    case Sonos::RenderingControl::DONE:
+        volumeMailbox.post(volumeSnapshot->volumeState());
+        break;
+    case Sonos::RenderingControl::FAILED:
+        break;
+    }
+    volumeSnapshot.reset();
+}
+
+String volumeSID;
+
 bool subscribeToVolumeChange() {
     String newSID;
 
@@ -348,6 +554,7 @@ bool subscribeToVolumeChange() {
     if (result) {
         Serial.print(F("Subscribed with new SID "));
         Serial.println(newSID);
+        volumeSID = newSID;
     } else {
         Serial.println(F("Subscription failed"));
     }
@@ -355,21 +562,131 @@ bool subscribeToVolumeChange() {
     return result;
 }
 
+String topologySID;
+
+// topology changes found by the event callback, acted upon in loop()
+bool topologyRoomMoved = false;
+bool topologyRoomLost = false;
+IPAddress topologyRoomSonosDeviceIp;
+
+class TopologyEventParser : public UPnP::EventParser {
+  public:
+    TopologyEventParser() : _roomUuid(config.sonos().roomUuid()), _update(roomDirectory), _parser([this](const Sonos::ZoneInfo &info) { _handleRoom(info); }) {
+    }
+
+    bool feed(Stream &stream) override {
+        _result = _parser.parseAvailable(stream);
+        return _result == XML::EncodedTagTokenizer::MORE;
+    }
+
+    void end() override {
+        if (_result == XML::EncodedTagTokenizer::ABORTED) {
+            // the directory is refreshed from the player instead; the room is looked up again with the next change
+            Serial.println(F("Failed to parse the zone group state of a topology event"));
+            roomDirectory.requestRefresh();
+            return;
+        }
+        if (_result != XML::EncodedTagTokenizer::DONE) {
+            // not every topology event carries the zone group state
+            return;
+        }
+
+        // the event contains the complete state, which keeps the room directory up to date for free
+        _update.commit();
+
+        if (!_found) {
+            Serial.println(F("The configured room has disappeared from the topology"));
+            topologyRoomLost = true;
+        } else if (_playerIP != roomSonosDeviceIp) {
+            Serial.print(F("The configured room has moved to "));
+            Serial.println(_playerIP);
+            topologyRoomSonosDeviceIp = _playerIP;
+            topologyRoomMoved = true;
+        }
+    }
+
+  private:
+    const char *_roomUuid;
+    bool _found = false;
+    IPAddress _playerIP;
+    Sonos::RoomDirectory::Update _update;
+    Sonos::ZoneGroupStateParser _parser;
+    XML::EncodedTagTokenizer::Result _result = XML::EncodedTagTokenizer::MORE;
+
+    void _handleRoom(const Sonos::ZoneInfo &info) {
+        if (info.uuid == _roomUuid) {
+            _playerIP = info.playerIP;
+            _found = true;
+        }
+        _update.add(info);
+    }
+};
+
+std::unique_ptr<UPnP::EventParser> topologyEventCallback(const String &SID) {
+    return std::unique_ptr<UPnP::EventParser>(new TopologyEventParser());
+}
+
+// the initial event contains the whole topology, which also confirms the player found so far
+// without a topology subscription, room changes go unnoticed, so a failed one is retried from AS_READY
+Timing::Backoff topologySubscribeBackoff(5000, 300000);
+
+bool subscribeToTopologyChange() {
+    String newSID;
+
+    topologyRoomMoved = false;
+    topologyRoomLost = false;
+
+    bool result = eventServer->subscribe(topologyEventCallback, "http://" + roomSonosDeviceIp.toString() + ":1400/ZoneGroupTopology/Event", &newSID);
+
+    if (result) {
+        Serial.print(F("Subscribed to topology with new SID "));
+        Serial.println(newSID);
+        topologySID = newSID;
+        topologySubscribeBackoff.reset();
+    } else {
+        topologySubscribeBackoff.failed(millis());
+        Serial.print(F("Topology subscription failed, trying again in "));
+        Serial.print(topologySubscribeBackoff.delayMillis());
+        Serial.println(F(" ms"));
+    }
+
+    return result;
+}
+
+// subscriptions the event server has given up renewing, acted upon in loop()
+bool volumeSubscriptionDropped = false;
+bool topologySubscriptionDropped = false;
+
+void subscriptionDroppedCallback(const String &SID) {
+    if (SID == volumeSID) {
+        volumeSID = "";
+        volumeSubscriptionDropped = true;
+    } else if (SID == topologySID) {
+        topologySID = "";
+        topologySubscriptionDropped = true;
+    }
+}
+
 void destroyEventServer() {
     eventServer.reset();
+    Sonos::presence.end();
+    volumeSID = "";
+    topologySID = "";
+    volumeSubscriptionDropped = false;
+    topologySubscriptionDropped = false;
 }
 
-// transform volume value in [0,1] to display value [0,1]
-float transform(float volume) {
+// transform volume value in [0,1] to display value [0,1], both Q16
+uint32_t transform(uint32_t volume) {
     switch (config.led().transform()) {
     case Config::LedConfig::Transform::IDENTITY:
         return volume;
     case Config::LedConfig::Transform::SQUARE:
-        return volume * volume;
+        return Color::squareQ16(volume);
     case Config::LedConfig::Transform::SQUARE_ROOT:
-        return sqrt(volume);
+        return Color::squareRootQ16(volume);
     case Config::LedConfig::Transform::INVERSE_SQUARE:
-        return volume * (2.0 - volume);
+        return Color::inverseSquareQ16(volume);
     default:
         Serial.println(F("Unknown transformation, using IDENTITY"));
         return volume;
@@ -384,14 +701,47 @@ typedef enum {
     AS_WIFI_GOT_IP,
     AS_WIFI_DISCONNECTED,
     AS_EVENT_SERVER_STARTED,
+    AS_DISCOVERING_ANY_SPEAKER,
     AS_ANY_SPEAKER_FOUND,
+    AS_LOOKING_UP_ROOM_SPEAKER,
     AS_ROOM_SPEAKER_FOUND,
     AS_EVENT_SUBSCRIBED,
+    AS_VERIFYING_ROOM_SPEAKER,
     AS_READY,
 } ApplicationState;
 
 ApplicationState applicationState;
 
+// set by the config server, acted upon in loop()
+bool sonosConfigChanged = false;
+
+// follow a changed Sonos configuration without restarting; only the volume subscription is re-targeted
+void retargetSonos() {
+    endNetworkLookups();
+    eventServer->unsubscribe(volumeSID);
+    volumeSID = "";
+    volumeSubscriptionDropped = false;
+    topologyRoomMoved = false;
+    topologyRoomLost = false;
+    display.notifyNotReady();
+
+    const Config::SonosConfig &sonosConfig = config.sonos();
+    if (!sonosConfig.active()) {
+        eventServer->unsubscribeAll();
+        topologySID = "";
+        topologySubscriptionDropped = false;
+        applicationState = AS_EVENT_SERVER_STARTED;
+    } else if (roomDirectory.find(sonosConfig.roomUuid(), &roomSonosDeviceIp)) {
+        // the directory follows the topology events; if the player doesn't respond, discovery is the fallback
+        roomSonosDeviceIpFromCache = true;
+        applicationState = AS_ROOM_SPEAKER_FOUND;
+    } else if (anySonosDeviceIp.isSet()) {
+        applicationState = AS_ANY_SPEAKER_FOUND;
+    } else {
+        applicationState = AS_EVENT_SERVER_STARTED;
+    }
+}
+
 void setup() {
     Serial.begin(115200);
 
@@ -401,6 +751,7 @@ void setup() {
     Color::RGB yellow = {255, 255, 0};
 
     // initialize color gradient for volume
+    Color::Gradient gradient;
     gradient.set(0 * LED_COUNT / 4, green);
     gradient.set(1 * LED_COUNT / 4 - 1, yellow);
     gradient.set(1 * LED_COUNT / 4, yellow);
@@ -409,14 +760,16 @@ void setup() {
     gradient.set(3 * LED_COUNT / 4 - 1, yellow);
     gradient.set(3 * LED_COUNT / 4, yellow);
     gradient.set(4 * LED_COUNT / 4 - 1, green);
+    display.setPattern(gradient);
 
     strip.Begin();
 
-    // load configuration from EEPROM
+    // load configuration from flash
     config.load();
 
-    // start display update ticker
-    displayUpdateTicker.attach_ms(40, []() { display.updateDisplay(transform); });
+    // the chip ID differs between displays, so their retries drift apart
+    sonosDiscoverBackoff.seed(ESP.getChipId());
+    topologySubscribeBackoff.seed(ESP.getChipId());
 
     applicationState = AS_INIT;
 
@@ -429,13 +782,34 @@ void setup() {
         destroyEventServer();
         ESP.restart();
     });
-    configServer.onAfterSonosConfigChange([]() {
-        destroyEventServer();
-        ESP.restart();
+    configServer.onAfterSonosConfigChange([]() { sonosConfigChanged = true; });
+    configServer.onAfterLedConfigChange([]() { display.notifyConfigChanged(); });
+    // no frames are rendered while the upload blocks the main loop, the dark strip shows that an update is in progress
+    configServer.onBeforeUpdate([]() { display.turnOff(); });
+    configServer.onAfterUpdate([](bool success) {
+        if (success) {
+            destroyEventServer();
+            ESP.restart();
+        }
+        // a failed upload has blocked the main loop as well, which says nothing about the frame timing
+        frameScheduler.restart();
     });
-    configServer.onAfterLedConfigChange([]() {
-        destroyEventServer();
-        ESP.restart();
+    configServer.onInfo([](JsonObject info) {
+        JsonObject displayInfo = info[F("display")].to<JsonObject>();
+        displayInfo[F("frames-computed")] = display.framesComputed();
+        displayInfo[F("frames-pushed")] = display.framesPushed();
+        displayInfo[F("frames-skipped")] = frameScheduler.framesSkipped();
+        displayInfo[F("frame-jitter-max-us")] = frameScheduler.maxJitterMicros();
+        displayInfo[F("frame-jitter-avg-us")] = frameScheduler.averageJitterMicros();
+        displayInfo[F("volume-events-coalesced")] = volumeMailbox.coalesced();
+        JsonObject discoveryInfo = info[F("discovery")].to<JsonObject>();
+        discoveryInfo[F("searches")] = sonosDiscoverSearches;
+        discoveryInfo[F("consecutive-failures")] = sonosDiscoverBackoff.failures();
+        discoveryInfo[F("retry-delay-ms")] = sonosDiscoverBackoff.delayMillis();
+        discoveryInfo[F("transmissions")] = sonosDiscover.search().transmissions();
+        discoveryInfo[F("responses")] = sonosDiscover.search().responses();
+        discoveryInfo[F("responses-dropped")] = sonosDiscover.search().dropped();
+        discoveryInfo[F("busy-us")] = sonosDiscover.search().busyMicros();
     });
     configServer.begin();
 
@@ -447,6 +821,7 @@ const uint8_t INITIAL_CONNECT_RETRIES = 3;
 void loop() {
     static uint8_t remainingConnectRetries = INITIAL_CONNECT_RETRIES;
     static bool allowIndefiniteWiFiReconnects = false;
+    static bool cachedPlayerTried = false;
     bool reconnect;
 
     switch (applicationState) {
@@ -483,41 +858,154 @@ void loop() {
     case AS_WIFI_GOT_IP:
         // configure event server and subscription when we got an IP
         startEventServer();
+        eventServer->onDrop(subscriptionDroppedCallback);
+        cachedPlayerTried = false;
+        sonosDiscoverBackoff.reset();
         applicationState = AS_EVENT_SERVER_STARTED;
         break;
     case AS_WIFI_DISCONNECTED:
         // notify display and destroy event server
         display.notifyNotReady();
         Serial.println(F("Disconnected from WiFi"));
+        endNetworkLookups();
         destroyEventServer();
+        HTTP::connectionPool.closeAll();
         applicationState = AS_WIFI_NOT_CONNECTED;
         break;
     case AS_EVENT_SERVER_STARTED:
-        // find any Sonos device
-        if (findSonosDeviceIp()) {
-            applicationState = AS_ANY_SPEAKER_FOUND;
+        // try the cached player once, then start searching for any Sonos device when the retry delay allows
+        if (!cachedPlayerTried && useCachedRoomSonosDeviceIp()) {
+            cachedPlayerTried = true;
+            roomSonosDeviceIpFromCache = true;
+            applicationState = AS_ROOM_SPEAKER_FOUND;
+        } else if (beginFindSonosDeviceIp()) {
+            applicationState = AS_DISCOVERING_ANY_SPEAKER;
+        }
+        break;
+    case AS_DISCOVERING_ANY_SPEAKER:
+        // handle discovery responses, start over if the search ends without a device
+        if (!pollFindSonosDeviceIp()) {
+            applicationState = foundSonosDeviceIp() ? AS_ANY_SPEAKER_FOUND : AS_EVENT_SERVER_STARTED;
         }
         break;
     case AS_ANY_SPEAKER_FOUND:
-        // find correct Sonos device
-        if (findRoomSonosDeviceIp()) {
+        // start looking up the correct Sonos device, fall back to discovery if that player can't be asked
+        if (beginFindRoomSonosDeviceIp()) {
+            applicationState = AS_LOOKING_UP_ROOM_SPEAKER;
+        } else {
+            sonosDeviceFailed(anySonosDeviceIp);
+            anySonosDeviceIp = IPAddress();
+            applicationState = AS_EVENT_SERVER_STARTED;
+        }
+        break;
+    case AS_LOOKING_UP_ROOM_SPEAKER:
+        // parse the next slice of the zone group state, fall back to discovery if the lookup fails
+        switch (pollFindRoomSonosDeviceIp()) {
+        case Sonos::ZoneGroupTopology::PENDING:
+            break;
+        case Sonos::ZoneGroupTopology::DONE:
             applicationState = AS_ROOM_SPEAKER_FOUND;
+            break;
+        case Sonos::ZoneGroupTopology::FAILED:
+            sonosDeviceFailed(anySonosDeviceIp);
+            anySonosDeviceIp = IPAddress();
+            applicationState = AS_EVENT_SERVER_STARTED;
+            break;
         }
         break;
     case AS_ROOM_SPEAKER_FOUND:
-        // subscribe to volume change
+        // subscribe to volume change, fall back to discovery if the player doesn't respond
         if (subscribeToVolumeChange()) {
+            volumeSubscriptionDropped = false;
+            beginVolumeSnapshot();
             applicationState = AS_EVENT_SUBSCRIBED;
+        } else if (roomSonosDeviceIpFromCache) {
+            // the cached player is only tried once, a search follows right away
+            roomSonosDeviceIpFromCache = false;
+            applicationState = AS_EVENT_SERVER_STARTED;
+        } else {
+            sonosDeviceFailed(roomSonosDeviceIp);
+            display.notifyNotReady();
+            applicationState = AS_EVENT_SERVER_STARTED;
         }
         break;
     case AS_EVENT_SUBSCRIBED:
         // notify the display
         display.notifyReady();
-        applicationState = AS_READY;
+        // follow topology changes, unless already subscribed before moving to another player
+        if (!topologySID.length()) {
+            subscribeToTopologyChange();
+            topologySubscriptionDropped = false;
+        }
+        if (roomSonosDeviceIpFromCache && !topologySID.length()) {
+            // without topology events, make sure the cached player still hosts the room, asking the player itself
+            anySonosDeviceIp = roomSonosDeviceIp;
+            applicationState = beginFindRoomSonosDeviceIp() ? AS_VERIFYING_ROOM_SPEAKER : AS_READY;
+        } else {
+            roomSonosDeviceIpFromCache = false;
+            cacheRoomSonosDeviceIp();
+            applicationState = AS_READY;
+        }
+        break;
+    case AS_VERIFYING_ROOM_SPEAKER:
+        // the volume is already shown while the zone group state is parsed in the background
+        switch (pollFindRoomSonosDeviceIp()) {
+        case Sonos::ZoneGroupTopology::PENDING:
+            break;
+        case Sonos::ZoneGroupTopology::DONE:
+            roomSonosDeviceIpFromCache = false;
+            if (roomSonosDeviceIp == anySonosDeviceIp) {
+                applicationState = AS_READY;
+            } else {
+                // the room has moved to another player, subscribe to that one instead
+                eventServer->unsubscribe(volumeSID);
+                applicationState = AS_ROOM_SPEAKER_FOUND;
+            }
+            break;
+        case Sonos::ZoneGroupTopology::FAILED:
+            // the room can't be confirmed, start from scratch
+            roomSonosDeviceIpFromCache = false;
+            eventServer->unsubscribe(volumeSID);
+            display.notifyNotReady();
+            applicationState = AS_EVENT_SERVER_STARTED;
+            break;
+        }
         break;
     case AS_READY:
         // allow indefinite WiFi reconnects
         allowIndefiniteWiFiReconnects = true;
+        if (topologyRoomLost) {
+            // start from scratch, the room might show up again on another player
+            topologyRoomLost = false;
+            topologyRoomMoved = false;
+            eventServer->unsubscribeAll();
+            volumeSID = "";
+            topologySID = "";
+            volumeSubscriptionDropped = false;
+            topologySubscriptionDropped = false;
+            display.notifyNotReady();
+            applicationState = AS_EVENT_SERVER_STARTED;
+        } else if (topologyRoomMoved) {
+            // re-target the volume subscription only
+            topologyRoomMoved = false;
+            eventServer->unsubscribe(volumeSID);
+            roomSonosDeviceIp = topologyRoomSonosDeviceIp;
+            applicationState = AS_ROOM_SPEAKER_FOUND;
+        } else if (volumeSubscriptionDropped) {
+            // the player doesn't know the subscription any more (e.g. after a restart), so subscribe again
+            // if the player doesn't respond any more, discovery is the fallback
+            volumeSubscriptionDropped = false;
+            roomSonosDeviceIpFromCache = true;
+            display.notifyNotReady();
+            applicationState = AS_ROOM_SPEAKER_FOUND;
+        } else if (topologySubscriptionDropped) {
+            // subscribed to again on the way back to ready
+            topologySubscriptionDropped = false;
+            applicationState = AS_EVENT_SUBSCRIBED;
+        } else if (!topologySID.length() && topologySubscribeBackoff.ready(millis())) {
+            // the subscription failed on the way to ready
+            subscribeToTopologyChange();
+        }
         break;
     }
 
@@ -526,5 +1014,38 @@ void loop() {
     }
     configServer.handleClient();
 
+    // apply Sonos configuration changes while connected; otherwise, they are picked up when connecting
+    if (sonosConfigChanged) {
+        sonosConfigChanged = false;
+        if (eventServer) {
+            retargetSonos();
+        }
+    }
+
+    // save deferred configuration changes
+    config.handle();
+
+    // room discovery for the config server runs in the background while connected, answered by announcements when possible
+    if (eventServer) {
+        Sonos::presence.handle();
+        roomDirectory.handle();
+    }
+
+    if (volumeSnapshot) {
+        pollVolumeSnapshot();
+    }
+
+    // close keep-alive connections nobody has used for a while
+    HTTP::connectionPool.evictIdle();
+
     ArduinoOTA.handle();
+
+    uint8_t frames = frameScheduler.poll();
+    if (frames) {
+        Sonos::VolumeState volumeState;
+        if (volumeMailbox.fetch(&volumeState)) {
+            display.notifyVolumeState(volumeState);
+        }
+        display.updateDisplay(transform, frames);
+    }
 }
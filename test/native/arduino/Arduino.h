@@ -0,0 +1,53 @@
+#ifndef NATIVE_ARDUINO_H_
+#define NATIVE_ARDUINO_H_
+
+// minimal host stand-in for the Arduino core, used by the native environment
+
+#include <cctype>
+#include <chrono>
+#include <cmath>
+#include <cstdint>
+#include <cstdlib>
+#include <cstring>
+
+#include "HardwareSerial.h"
+#include "Stream.h"
+#include "WString.h"
+#include "pgmspace.h"
+
+#ifndef PI
+#define PI 3.1415926535897932384626433832795
+#endif
+
+typedef bool boolean;
+
+// tests can take over the clock, e.g. to step it across the overflow
+namespace NativeClock {
+inline bool manual = false;
+inline unsigned long nowMicros = 0;
+
+inline void set(unsigned long micros) {
+    manual = true;
+    nowMicros = micros;
+}
+} // namespace NativeClock
+
+inline unsigned long micros() {
+    if (NativeClock::manual) {
+        return NativeClock::nowMicros;
+    }
+    static const auto start = std::chrono::steady_clock::now();
+    return std::chrono::duration_cast<std::chrono::microseconds>(std::chrono::steady_clock::now() - start).count();
+}
+
+inline unsigned long millis() {
+    return micros() / 1000;
+}
+
+inline void delay(unsigned long) {
+}
+
+inline void yield() {
+}
+
+#endif /* NATIVE_ARDUINO_H_ */
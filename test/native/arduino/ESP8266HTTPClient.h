@@ -0,0 +1,70 @@
+#ifndef NATIVE_ESP8266HTTPCLIENT_H_
+#define NATIVE_ESP8266HTTPCLIENT_H_
+
+#include <cstdint>
+
+#include "WString.h"
+#include "WiFiClient.h"
+
+#define HTTPC_ERROR_CONNECTION_FAILED (-1)
+
+// host stand-in, modeling how the ESP8266 HTTPClient handles its underlying client:
+// begin() takes the client, end() keeps it only if the connection may be reused, otherwise it is stopped and dropped
+class HTTPClient {
+  public:
+    bool begin(WiFiClient &client, const String &host, uint16_t port, const String &uri) {
+        _client = &client;
+        _host = host;
+        _port = port;
+        _uri = uri;
+        return true;
+    }
+
+    // a path only replaces the URI, the client is left alone
+    bool setURL(const String &url) {
+        if (!url.startsWith("/")) {
+            return false;
+        }
+        _uri = url;
+        return true;
+    }
+
+    void setReuse(bool reuse) {
+        _reuse = reuse;
+    }
+
+    bool connected() {
+        return _client && _client->connected();
+    }
+
+    // every response allows keep-alive
+    int GET() {
+        if (!_client) {
+            return HTTPC_ERROR_CONNECTION_FAILED;
+        }
+        if (!_client->connected() && !_client->connect(_host, _port)) {
+            return HTTPC_ERROR_CONNECTION_FAILED;
+        }
+        return 200;
+    }
+
+    void end() {
+        if (_client && !_reuse) {
+            _client->stop();
+            _client = nullptr;
+        }
+    }
+
+    const String &uri() const {
+        return _uri;
+    }
+
+  private:
+    WiFiClient *_client = nullptr;
+    String _host;
+    uint16_t _port = 0;
+    String _uri;
+    bool _reuse = false;
+};
+
+#endif /* NATIVE_ESP8266HTTPCLIENT_H_ */
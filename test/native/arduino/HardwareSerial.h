@@ -0,0 +1,43 @@
+#ifndef NATIVE_HARDWARESERIAL_H_
+#define NATIVE_HARDWARESERIAL_H_
+
+#include <cstdio>
+
+#include "Stream.h"
+
+// host stand-in: output goes to stderr if enabled, so it doesn't disturb benchmark reports on stdout
+class HardwareSerial : public Stream {
+  public:
+    void begin(unsigned long) {
+    }
+
+    void enable(bool enabled) {
+        _enabled = enabled;
+    }
+
+    size_t write(uint8_t ch) override {
+        if (_enabled) {
+            fputc(ch, stderr);
+        }
+        return 1;
+    }
+
+    using Print::write;
+
+    int available() override {
+        return 0;
+    }
+    int read() override {
+        return -1;
+    }
+    int peek() override {
+        return -1;
+    }
+
+  private:
+    bool _enabled = false;
+};
+
+inline HardwareSerial Serial;
+
+#endif /* NATIVE_HARDWARESERIAL_H_ */
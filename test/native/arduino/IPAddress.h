@@ -0,0 +1,56 @@
+#ifndef NATIVE_IPADDRESS_H_
+#define NATIVE_IPADDRESS_H_
+
+#include <cstdint>
+#include <cstdio>
+
+#include "WString.h"
+
+class IPAddress {
+  public:
+    IPAddress() : _address(0) {
+    }
+    IPAddress(uint8_t a, uint8_t b, uint8_t c, uint8_t d) : _address(a | b << 8 | c << 16 | static_cast<uint32_t>(d) << 24) {
+    }
+    IPAddress(uint32_t address) : _address(address) {
+    }
+
+    operator uint32_t() const {
+        return _address;
+    }
+
+    bool operator==(const IPAddress &other) const {
+        return _address == other._address;
+    }
+    bool operator!=(const IPAddress &other) const {
+        return _address != other._address;
+    }
+
+    bool isSet() const {
+        return _address != 0;
+    }
+
+    bool fromString(const char *address) {
+        unsigned int a, b, c, d;
+        char rest;
+        if (sscanf(address, "%u.%u.%u.%u%c", &a, &b, &c, &d, &rest) != 4 || a > 255 || b > 255 || c > 255 || d > 255) {
+            return false;
+        }
+        *this = IPAddress(a, b, c, d);
+        return true;
+    }
+    bool fromString(const String &address) {
+        return fromString(address.c_str());
+    }
+
+    String toString() const {
+        char buf[16];
+        snprintf(buf, sizeof(buf), "%u.%u.%u.%u", _address & 0xFF, (_address >> 8) & 0xFF, (_address >> 16) & 0xFF, _address >> 24);
+        return String(buf);
+    }
+
+  private:
+    uint32_t _address;
+};
+
+#endif /* NATIVE_IPADDRESS_H_ */
@@ -0,0 +1,80 @@
+#ifndef NATIVE_PRINT_H_
+#define NATIVE_PRINT_H_
+
+#include <cstdarg>
+#include <cstddef>
+#include <cstdint>
+#include <cstdio>
+#include <cstring>
+
+#include "WString.h"
+#include "pgmspace.h"
+
+class Print {
+  public:
+    virtual ~Print() {
+    }
+
+    virtual size_t write(uint8_t ch) = 0;
+
+    virtual size_t write(const uint8_t *buffer, size_t size) {
+        size_t n = 0;
+        while (size--) {
+            n += write(*buffer++);
+        }
+        return n;
+    }
+
+    size_t write(const char *s) {
+        return write(reinterpret_cast<const uint8_t *>(s), strlen(s));
+    }
+
+    size_t print(const char *s) {
+        return write(s);
+    }
+    size_t print(const __FlashStringHelper *s) {
+        return write(reinterpret_cast<const char *>(s));
+    }
+    size_t print(const String &s) {
+        return write(s.c_str());
+    }
+    size_t print(char c) {
+        return write(static_cast<uint8_t>(c));
+    }
+    size_t print(long value) {
+        char buf[24];
+        snprintf(buf, sizeof(buf), "%ld", value);
+        return write(buf);
+    }
+    size_t print(unsigned long value) {
+        char buf[24];
+        snprintf(buf, sizeof(buf), "%lu", value);
+        return write(buf);
+    }
+    size_t print(int value) {
+        return print(static_cast<long>(value));
+    }
+    size_t print(unsigned int value) {
+        return print(static_cast<unsigned long>(value));
+    }
+
+    template <typename T> size_t println(const T &value) {
+        return print(value) + println();
+    }
+    size_t println() {
+        return write("\r\n");
+    }
+
+    size_t printf(const char *format, ...) __attribute__((format(printf, 2, 3))) {
+        char buf[256];
+        va_list args;
+        va_start(args, format);
+        int length = vsnprintf(buf, sizeof(buf), format, args);
+        va_end(args);
+        return length > 0 ? write(reinterpret_cast<const uint8_t *>(buf), length < static_cast<int>(sizeof(buf)) ? length : sizeof(buf) - 1) : 0;
+    }
+};
+
+#define printf_P printf
+
+#endif /* NATIVE_PRINT_H_ */
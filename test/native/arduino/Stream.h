@@ -0,0 +1,38 @@
+#ifndef NATIVE_STREAM_H_
+#define NATIVE_STREAM_H_
+
+#include <cstddef>
+
+#include "Print.h"
+
+class Stream : public Print {
+  public:
+    virtual int available() = 0;
+    virtual int read() = 0;
+    virtual int peek() = 0;
+
+    void setTimeout(unsigned long timeout) {
+        _timeout = timeout;
+    }
+    unsigned long getTimeout() const {
+        return _timeout;
+    }
+
+    // host streams are never "slow", so the timed read degenerates to a plain read
+    virtual size_t readBytes(char *buffer, size_t length) {
+        size_t count = 0;
+        while (count < length) {
+            int ch = read();
+            if (ch < 0) {
+                break;
+            }
+            buffer[count++] = static_cast<char>(ch);
+        }
+        return count;
+    }
+
+  protected:
+    unsigned long _timeout = 1000;
+};
+
+#endif /* NATIVE_STREAM_H_ */
@@ -0,0 +1,148 @@
+#ifndef NATIVE_WSTRING_H_
+#define NATIVE_WSTRING_H_
+
+// host stand-in for the Arduino String, just enough for the code under test
+// storage is allocated with new[], so allocation counting in the harness sees it
+
+#include <cstdlib>
+#include <cstring>
+#include <string>
+
+#include "pgmspace.h"
+
+class String {
+  public:
+    String(const char *s = "") {
+        _assign(s, strlen(s));
+    }
+    String(const __FlashStringHelper *s) : String(reinterpret_cast<const char *>(s)) {
+    }
+    String(const String &other) {
+        _assign(other._buffer, other._length);
+    }
+    explicit String(char c) {
+        _assign(&c, 1);
+    }
+    explicit String(int value, unsigned char base = 10) : String(static_cast<long>(value), base) {
+    }
+    explicit String(unsigned int value, unsigned char base = 10) : String(static_cast<unsigned long>(value), base) {
+    }
+    explicit String(long value, unsigned char base = 10) {
+        char buf[24];
+        snprintf(buf, sizeof(buf), base == 16 ? "%lx" : "%ld", value);
+        _assign(buf, strlen(buf));
+    }
+    explicit String(unsigned long value, unsigned char base = 10) {
+        char buf[24];
+        snprintf(buf, sizeof(buf), base == 16 ? "%lx" : "%lu", value);
+        _assign(buf, strlen(buf));
+    }
+    ~String() {
+        delete[] _buffer;
+    }
+
+    String &operator=(const String &other) {
+        if (this != &other) {
+            delete[] _buffer;
+            _assign(other._buffer, other._length);
+        }
+        return *this;
+    }
+
+    const char *c_str() const {
+        return _buffer;
+    }
+    unsigned int length() const {
+        return _length;
+    }
+    char operator[](unsigned int index) const {
+        return index < _length ? _buffer[index] : 0;
+    }
+
+    String &operator+=(const String &other) {
+        return _append(other._buffer, other._length);
+    }
+    String &operator+=(const char *s) {
+        return _append(s, strlen(s));
+    }
+    String &operator+=(char c) {
+        return _append(&c, 1);
+    }
+
+    bool operator==(const String &other) const {
+        return _length == other._length && !memcmp(_buffer, other._buffer, _length);
+    }
+    bool operator==(const char *s) const {
+        return !strcmp(_buffer, s);
+    }
+    bool operator!=(const String &other) const {
+        return !(*this == other);
+    }
+    bool operator!=(const char *s) const {
+        return !(*this == s);
+    }
+    bool operator<(const String &other) const {
+        return strcmp(_buffer, other._buffer) < 0;
+    }
+
+    bool startsWith(const String &prefix) const {
+        return prefix._length <= _length && !memcmp(_buffer, prefix._buffer, prefix._length);
+    }
+    bool endsWith(const String &suffix) const {
+        return suffix._length <= _length && !memcmp(_buffer + _length - suffix._length, suffix._buffer, suffix._length);
+    }
+    int indexOf(char c, unsigned int from = 0) const {
+        const char *p = from < _length ? strchr(_buffer + from, c) : nullptr;
+        return p ? p - _buffer : -1;
+    }
+    int indexOf(const String &s, unsigned int from = 0) const {
+        const char *p = from < _length ? strstr(_buffer + from, s._buffer) : nullptr;
+        return p ? p - _buffer : -1;
+    }
+    String substring(unsigned int from, unsigned int to) const {
+        if (to > _length) {
+            to = _length;
+        }
+        return from < to ? String(_buffer + from, to - from) : String();
+    }
+    String substring(unsigned int from) const {
+        return substring(from, _length);
+    }
+    long toInt() const {
+        return atol(_buffer);
+    }
+
+  private:
+    char *_buffer;
+    unsigned int _length;
+
+    String(const char *s, unsigned int length) {
+        _assign(s, length);
+    }
+
+    void _assign(const char *s, unsigned int length) {
+        _buffer = new char[length + 1];
+        memcpy(_buffer, s, length);
+        _buffer[length] = '\0';
+        _length = length;
+    }
+
+    String &_append(const char *s, unsigned int length) {
+        char *buffer = new char[_length + length + 1];
+        memcpy(buffer, _buffer, _length);
+        memcpy(buffer + _length, s, length);
+        buffer[_length + length] = '\0';
+        delete[] _buffer;
+        _buffer = buffer;
+        _length += length;
+        return *this;
+    }
+};
+
+inline String operator+(const String &a, const String &b) {
+    String result(a);
+    result += b;
+    return result;
+}
+
+#endif /* NATIVE_WSTRING_H_ */
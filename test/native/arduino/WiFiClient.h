@@ -0,0 +1,36 @@
+#ifndef NATIVE_WIFICLIENT_H_
+#define NATIVE_WIFICLIENT_H_
+
+#include <cstdint>
+
+#include "IPAddress.h"
+#include "WString.h"
+
+// host stand-in: there is no network, a connection is just a flag
+// the peer closing the connection is simulated with stop()
+class WiFiClient {
+  public:
+    bool connect(const String &host, uint16_t port) {
+        (void)host;
+        (void)port;
+        _connected = true;
+        connects++;
+        return true;
+    }
+
+    bool connected() {
+        return _connected;
+    }
+
+    void stop() {
+        _connected = false;
+    }
+
+    // connections opened by all clients
+    inline static unsigned int connects = 0;
+
+  private:
+    bool _connected = false;
+};
+
+#endif /* NATIVE_WIFICLIENT_H_ */
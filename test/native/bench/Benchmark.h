@@ -0,0 +1,101 @@
+#ifndef NATIVE_BENCHMARK_H_
+#define NATIVE_BENCHMARK_H_
+
+// host benchmark harness: wall clock timing plus heap accounting
+// replaces the global operator new/delete, so it must be included by exactly one translation unit per test program
+
+#include <chrono>
+#include <cstddef>
+#include <cstdio>
+#include <cstdlib>
+#include <new>
+
+namespace Benchmark {
+
+struct HeapStats {
+    size_t allocations = 0;
+    size_t currentBytes = 0;
+    size_t peakBytes = 0;
+};
+
+inline HeapStats heapStats;
+
+struct Result {
+    double nsPerIteration;
+    double allocationsPerIteration;
+    size_t peakHeapBytes;
+};
+
+// run body for the given number of iterations and report time, allocations and peak heap usage per iteration
+// the peak heap is measured relative to the heap usage before the first iteration
+template <typename F> Result run(const char *name, unsigned long iterations, F body) {
+    // warm up, so one-time allocations don't show up in the numbers
+    body();
+
+    size_t allocationsBefore = heapStats.allocations;
+    size_t bytesBefore = heapStats.currentBytes;
+    heapStats.peakBytes = bytesBefore;
+
+    auto start = std::chrono::steady_clock::now();
+    for (unsigned long i = 0; i < iterations; i++) {
+        body();
+    }
+    auto end = std::chrono::steady_clock::now();
+
+    Result result;
+    result.nsPerIteration = std::chrono::duration<double, std::nano>(end - start).count() / iterations;
+    result.allocationsPerIteration = static_cast<double>(heapStats.allocations - allocationsBefore) / iterations;
+    result.peakHeapBytes = heapStats.peakBytes - bytesBefore;
+
+    printf("%-48s %12.1f ns/op %8.2f allocs/op %8zu bytes peak heap\n", name, result.nsPerIteration, result.allocationsPerIteration, result.peakHeapBytes);
+    return result;
+}
+
+} // namespace Benchmark
+
+// every block carries its size in front, so delete can account for it
+static const size_t BENCHMARK_HEADER_SIZE = alignof(std::max_align_t);
+
+// the replacements are kept out of line: inlined into their callers, GCC pairs the shifted malloc()/free() with the
+// new and delete expressions and reports mismatched deallocations, out of bounds accesses and uses after free
+#define BENCHMARK_REPLACEMENT __attribute__((noinline))
+
+BENCHMARK_REPLACEMENT void *operator new(size_t size) {
+    char *block = static_cast<char *>(malloc(size + BENCHMARK_HEADER_SIZE));
+    if (!block) {
+        throw std::bad_alloc();
+    }
+    *reinterpret_cast<size_t *>(block) = size;
+    Benchmark::heapStats.allocations++;
+    Benchmark::heapStats.currentBytes += size;
+    if (Benchmark::heapStats.currentBytes > Benchmark::heapStats.peakBytes) {
+        Benchmark::heapStats.peakBytes = Benchmark::heapStats.currentBytes;
+    }
+    return block + BENCHMARK_HEADER_SIZE;
+}
+
+BENCHMARK_REPLACEMENT void *operator new[](size_t size) {
+    return operator new(size);
+}
+
+BENCHMARK_REPLACEMENT void operator delete(void *p) noexcept {
+    if (p) {
+        char *block = static_cast<char *>(p) - BENCHMARK_HEADER_SIZE;
+        Benchmark::heapStats.currentBytes -= *reinterpret_cast<size_t *>(block);
+        free(block);
+    }
+}
+
+BENCHMARK_REPLACEMENT void operator delete[](void *p) noexcept {
+    operator delete(p);
+}
+
+BENCHMARK_REPLACEMENT void operator delete(void *p, size_t) noexcept {
+    operator delete(p);
+}
+
+BENCHMARK_REPLACEMENT void operator delete[](void *p, size_t) noexcept {
+    operator delete(p);
+}
+
+#endif /* NATIVE_BENCHMARK_H_ */
@@ -0,0 +1,50 @@
+#ifndef NATIVE_MEMORYSTREAM_H_
+#define NATIVE_MEMORYSTREAM_H_
+
+#include <Stream.h>
+#include <algorithm>
+#include <cstring>
+
+// read-only stream over a recorded payload, rewindable for replaying it many times
+class MemoryStream : public Stream {
+  public:
+    MemoryStream(const char *data, size_t length) : _data(data), _length(length) {
+    }
+    explicit MemoryStream(const char *data) : MemoryStream(data, strlen(data)) {
+    }
+
+    void rewind() {
+        _position = 0;
+    }
+
+    int available() override {
+        return _length - _position;
+    }
+
+    int read() override {
+        return _position < _length ? static_cast<unsigned char>(_data[_position++]) : -1;
+    }
+
+    int peek() override {
+        return _position < _length ? static_cast<unsigned char>(_data[_position]) : -1;
+    }
+
+    // bulk read, like WiFiClient does
+    size_t readBytes(char *buffer, size_t length) override {
+        size_t count = std::min(length, _length - _position);
+        memcpy(buffer, _data + _position, count);
+        _position += count;
+        return count;
+    }
+
+    size_t write(uint8_t) override {
+        return 0;
+    }
+
+  private:
+    const char *_data;
+    size_t _length;
+    size_t _position = 0;
+};
+
+#endif /* NATIVE_MEMORYSTREAM_H_ */
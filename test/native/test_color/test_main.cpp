@@ -0,0 +1,148 @@
+#include <unity.h>
+
+#include <Benchmark.h>
+
+#include <cmath>
+
+#include "Color/FixedPoint.h"
+#include "Color/Gradient.h"
+#include "Color/RGB.h"
+
+const uint16_t LED_COUNT = 24;
+
+void setUp() {
+}
+
+void tearDown() {
+}
+
+// the gradient used for the volume display
+static Color::Gradient volumeGradient() {
+    Color::RGB red = {255, 0, 0};
+    Color::RGB green = {0, 255, 0};
+    Color::RGB yellow = {255, 255, 0};
+
+    Color::Gradient gradient;
+    gradient.set(0 * LED_COUNT / 4, green);
+    gradient.set(1 * LED_COUNT / 4 - 1, yellow);
+    gradient.set(1 * LED_COUNT / 4, yellow);
+    gradient.set(2 * LED_COUNT / 4 - 1, red);
+    gradient.set(2 * LED_COUNT / 4, red);
+    gradient.set(3 * LED_COUNT / 4 - 1, yellow);
+    gradient.set(3 * LED_COUNT / 4, yellow);
+    gradient.set(4 * LED_COUNT / 4 - 1, green);
+    return gradient;
+}
+
+static void assertBakeMatchesGet(const Color::Gradient &gradient, uint16_t length) {
+    Color::RGB table[64];
+    TEST_ASSERT_TRUE(length <= 64);
+    gradient.bake(table, length);
+    for (uint16_t pos = 0; pos < length; pos++) {
+        Color::RGB expected = gradient.get(pos);
+        TEST_ASSERT_EQUAL_UINT8(expected.red, table[pos].red);
+        TEST_ASSERT_EQUAL_UINT8(expected.green, table[pos].green);
+        TEST_ASSERT_EQUAL_UINT8(expected.blue, table[pos].blue);
+    }
+}
+
+void test_bake_matches_get_for_volume_gradient() {
+    assertBakeMatchesGet(volumeGradient(), LED_COUNT);
+}
+
+void test_bake_matches_get_outside_of_entries() {
+    Color::Gradient gradient;
+    gradient.set(10, {10, 20, 30});
+    gradient.set(20, {200, 100, 0});
+    gradient.set(21, {0, 0, 255});
+    gradient.set(40, {255, 255, 255});
+    assertBakeMatchesGet(gradient, 64);
+}
+
+void test_bake_matches_get_for_single_entry() {
+    Color::Gradient gradient;
+    gradient.set(5, {1, 2, 3});
+    assertBakeMatchesGet(gradient, 16);
+}
+
+void benchmark_get_per_led() {
+    Color::Gradient gradient = volumeGradient();
+    Color::RGB table[LED_COUNT];
+    Benchmark::run("Gradient::get per LED", 100000, [&gradient, &table]() {
+        for (uint16_t i = 0; i < LED_COUNT; i++) {
+            table[i] = gradient.get(i);
+        }
+        asm volatile("" : : "r"(table) : "memory");
+    });
+}
+
+void benchmark_bake() {
+    Color::Gradient gradient = volumeGradient();
+    Color::RGB table[LED_COUNT];
+    Benchmark::run("Gradient::bake", 100000, [&gradient, &table]() {
+        gradient.bake(table, LED_COUNT);
+        asm volatile("" : : "r"(table) : "memory");
+    });
+}
+
+// LED position of the bar in Q8, as the display computes it from the Q16 level
+static void assertTransformMatchesFloat(uint32_t (*fixed)(uint32_t), float (*reference)(float)) {
+    for (uint32_t level = 0; level <= 65536; level++) {
+        uint32_t transformed = fixed(level);
+        float exact = reference(level / 65536.0f);
+        // at most 1 LSB below the exact value in Q16
+        TEST_ASSERT_TRUE(transformed <= exact * 65536 + 0.01f);
+        TEST_ASSERT_TRUE(transformed + 1 >= exact * 65536 - 0.01f);
+        // which is within 1 LSB of the LED position in Q8
+        uint32_t position = LED_COUNT / 2 * transformed >> 8;
+        TEST_ASSERT_INT_WITHIN(1, static_cast<int32_t>(floor(LED_COUNT / 2 * exact * 256)), position);
+    }
+}
+
+void test_square_matches_float() {
+    assertTransformMatchesFloat(Color::squareQ16, [](float x) { return x * x; });
+}
+
+void test_square_root_matches_float() {
+    // double precision, float sqrt is not exact enough to check the last bit
+    assertTransformMatchesFloat(Color::squareRootQ16, [](float x) { return static_cast<float>(sqrt(static_cast<double>(x))); });
+}
+
+void test_inverse_square_matches_float() {
+    assertTransformMatchesFloat(Color::inverseSquareQ16, [](float x) { return x * (2.0f - x); });
+}
+
+// the edge LED is blended from black, like LinearBlend(0, color, fraction) truncates it
+void test_scale8_matches_float_blend() {
+    for (int value = 0; value < 256; value++) {
+        for (int fraction = 0; fraction < 4096; fraction++) {
+            float exact = fraction / 4096.0f;
+            uint8_t expected = static_cast<uint8_t>(value * exact);
+            TEST_ASSERT_INT_WITHIN(1, expected, Color::scale8(value, fraction >> 4));
+        }
+    }
+}
+
+void benchmark_square_root() {
+    uint32_t level = 0;
+    Benchmark::run("Color::squareRootQ16", 1000000, [&level]() {
+        uint32_t root = Color::squareRootQ16(level);
+        level = (level + 4099) & 0xffff;
+        asm volatile("" : : "r"(root) : "memory");
+    });
+}
+
+int main() {
+    UNITY_BEGIN();
+    RUN_TEST(test_bake_matches_get_for_volume_gradient);
+    RUN_TEST(test_bake_matches_get_outside_of_entries);
+    RUN_TEST(test_bake_matches_get_for_single_entry);
+    RUN_TEST(test_square_matches_float);
+    RUN_TEST(test_square_root_matches_float);
+    RUN_TEST(test_inverse_square_matches_float);
+    RUN_TEST(test_scale8_matches_float_blend);
+    RUN_TEST(benchmark_get_per_led);
+    RUN_TEST(benchmark_bake);
+    RUN_TEST(benchmark_square_root);
+    return UNITY_END();
+}
@@ -0,0 +1,355 @@
+#include <unity.h>
+
+#include <Benchmark.h>
+
+#include <cstring>
+#include <type_traits>
+#include <vector>
+
+#include "Config/Journal.h"
+#include "Config/LedConfig.h"
+#include "Config/PersistentConfig.h"
+#include "Config/SonosConfig.h"
+#include "Util/CRC32.h"
+
+const unsigned long ITERATIONS = 10000;
+
+// bit-at-a-time CRC32, as PersistentConfig used to calculate it
+static uint32_t bitwiseCrc32(const void *data, size_t length) {
+    uint32_t crc = 0xffffffff;
+    const uint8_t *p = reinterpret_cast<const uint8_t *>(data);
+    for (size_t i = length; i; i--, p++) {
+        crc ^= *p;
+        for (int8_t j = 7; j >= 0; j--) {
+            crc = (crc >> 1) ^ (0xEDB88320 & (-(crc & 1)));
+        }
+    }
+    return crc ^ 0xffffffff;
+}
+
+// flash stand-in: erase sets all bits, writes can only clear them
+// writeBudget simulates a power loss after the given number of bytes
+class RamStorage : public Config::Journal::Storage {
+  public:
+    RamStorage(size_t sectorSize, uint16_t sectorCount) : data(sectorSize * sectorCount, 0xff), _sectorSize(sectorSize), _sectorCount(sectorCount) {
+    }
+
+    size_t sectorSize() const override {
+        return _sectorSize;
+    }
+
+    uint16_t sectorCount() const override {
+        return _sectorCount;
+    }
+
+    bool read(uint32_t offset, void *buffer, size_t size) override {
+        if (offset % 4 || size % 4 || offset + size > data.size()) {
+            return false;
+        }
+        memcpy(buffer, &data[offset], size);
+        return true;
+    }
+
+    bool write(uint32_t offset, const void *buffer, size_t size) override {
+        if (offset % 4 || size % 4 || offset + size > data.size()) {
+            return false;
+        }
+        const uint8_t *p = static_cast<const uint8_t *>(buffer);
+        for (size_t i = 0; i < size; i++) {
+            if (!writeBudget) {
+                return false;
+            }
+            writeBudget--;
+            data[offset + i] &= p[i];
+        }
+        return true;
+    }
+
+    bool erase(uint16_t sector) override {
+        if (sector >= _sectorCount) {
+            return false;
+        }
+        memset(&data[sector * _sectorSize], 0xff, _sectorSize);
+        erases++;
+        return true;
+    }
+
+    std::vector<uint8_t> data;
+    size_t writeBudget = SIZE_MAX;
+    unsigned int erases = 0;
+
+  private:
+    size_t _sectorSize;
+    uint16_t _sectorCount;
+};
+
+struct Settings {
+    char name[33];
+    uint8_t brightness;
+};
+
+const uint32_t MAGIC = 0x51DEB00B;
+
+void setUp() {
+}
+
+void tearDown() {
+}
+
+void test_empty_storage_is_formatted() {
+    RamStorage storage(256, 4);
+    Config::Journal journal(storage, MAGIC);
+
+    TEST_ASSERT_TRUE(journal.begin());
+    Settings settings;
+    TEST_ASSERT_FALSE(journal.read(0, &settings, sizeof(settings)));
+    TEST_ASSERT_EQUAL_UINT(1, storage.erases);
+}
+
+void test_newest_record_is_recovered() {
+    RamStorage storage(256, 4);
+    {
+        Config::Journal journal(storage, MAGIC);
+        journal.begin();
+        Settings settings = {"kitchen", 10};
+        for (uint8_t brightness = 10; brightness < 40; brightness++) {
+            settings.brightness = brightness;
+            TEST_ASSERT_TRUE(journal.append(0, &settings, sizeof(settings)));
+        }
+        uint32_t ip = 0x6901A8C0;
+        TEST_ASSERT_TRUE(journal.append(1, &ip, sizeof(ip)));
+    }
+
+    Config::Journal journal(storage, MAGIC);
+    TEST_ASSERT_TRUE(journal.begin());
+    Settings settings;
+    TEST_ASSERT_TRUE(journal.read(0, &settings, sizeof(settings)));
+    TEST_ASSERT_EQUAL_STRING("kitchen", settings.name);
+    TEST_ASSERT_EQUAL_UINT8(39, settings.brightness);
+    uint32_t ip;
+    TEST_ASSERT_TRUE(journal.read(1, &ip, sizeof(ip)));
+    TEST_ASSERT_EQUAL_HEX32(0x6901A8C0, ip);
+    // a record of the wrong size is not returned
+    TEST_ASSERT_FALSE(journal.read(1, &settings, sizeof(settings)));
+}
+
+void test_sectors_are_only_erased_when_full() {
+    RamStorage storage(4096, 4);
+    Config::Journal journal(storage, MAGIC);
+    journal.begin();
+
+    // a record takes 8 + 36 + 4 bytes, so a sector holds 85 of them
+    Settings settings = {"kitchen", 0};
+    for (int i = 0; i < 85; i++) {
+        settings.brightness = i;
+        TEST_ASSERT_TRUE(journal.append(0, &settings, sizeof(settings)));
+    }
+    TEST_ASSERT_EQUAL_UINT(1, storage.erases);
+    settings.brightness = 85;
+    TEST_ASSERT_TRUE(journal.append(0, &settings, sizeof(settings)));
+    TEST_ASSERT_EQUAL_UINT(2, storage.erases);
+}
+
+void test_unchanged_record_is_not_written() {
+    RamStorage storage(256, 2);
+    Config::Journal journal(storage, MAGIC);
+    journal.begin();
+
+    Settings settings = {"kitchen", 10};
+    TEST_ASSERT_TRUE(journal.append(0, &settings, sizeof(settings)));
+    storage.writeBudget = 0;
+    TEST_ASSERT_TRUE(journal.append(0, &settings, sizeof(settings)));
+}
+
+void test_compaction_keeps_all_records() {
+    RamStorage storage(256, 2);
+    {
+        Config::Journal journal(storage, MAGIC);
+        journal.begin();
+        uint32_t ip = 0x6901A8C0;
+        journal.append(1, &ip, sizeof(ip));
+        // many compactions, every one of them has to carry the other record over
+        Settings settings = {"kitchen", 0};
+        for (int i = 0; i < 100; i++) {
+            settings.brightness = i;
+            TEST_ASSERT_TRUE(journal.append(0, &settings, sizeof(settings)));
+        }
+        TEST_ASSERT_GREATER_THAN_UINT(10, journal.erases());
+    }
+
+    Config::Journal journal(storage, MAGIC);
+    TEST_ASSERT_TRUE(journal.begin());
+    uint32_t ip;
+    TEST_ASSERT_TRUE(journal.read(1, &ip, sizeof(ip)));
+    TEST_ASSERT_EQUAL_HEX32(0x6901A8C0, ip);
+    Settings settings;
+    TEST_ASSERT_TRUE(journal.read(0, &settings, sizeof(settings)));
+    TEST_ASSERT_EQUAL_UINT8(99, settings.brightness);
+}
+
+void test_interrupted_append_keeps_previous_version() {
+    for (size_t budget = 0; budget < 48; budget += 4) {
+        RamStorage storage(256, 3);
+        Settings settings = {"kitchen", 10};
+        {
+            Config::Journal journal(storage, MAGIC);
+            journal.begin();
+            journal.append(0, &settings, sizeof(settings));
+            settings.brightness = 20;
+            storage.writeBudget = budget;
+            TEST_ASSERT_FALSE(journal.append(0, &settings, sizeof(settings)));
+        }
+        storage.writeBudget = SIZE_MAX;
+
+        Config::Journal journal(storage, MAGIC);
+        TEST_ASSERT_TRUE(journal.begin());
+        TEST_ASSERT_TRUE(journal.read(0, &settings, sizeof(settings)));
+        TEST_ASSERT_EQUAL_UINT8(10, settings.brightness);
+
+        // appending continues behind the remains of the interrupted write
+        settings.brightness = 30;
+        TEST_ASSERT_TRUE(journal.append(0, &settings, sizeof(settings)));
+        Config::Journal reloaded(storage, MAGIC);
+        TEST_ASSERT_TRUE(reloaded.begin());
+        TEST_ASSERT_TRUE(reloaded.read(0, &settings, sizeof(settings)));
+        TEST_ASSERT_EQUAL_UINT8(30, settings.brightness);
+    }
+}
+
+void test_interrupted_compaction_keeps_all_records() {
+    // sector header, the two records that are carried over, and the new record
+    for (size_t budget = 0; budget < 8 + 16 + 48 + 48; budget += 4) {
+        RamStorage storage(256, 3);
+        Settings settings = {"kitchen", 0};
+        uint32_t ip = 0x6901A8C0;
+        {
+            Config::Journal journal(storage, MAGIC);
+            journal.begin();
+            journal.append(1, &ip, sizeof(ip));
+            // fill the first sector
+            for (int i = 0; i < 4; i++) {
+                settings.brightness = i;
+                journal.append(0, &settings, sizeof(settings));
+            }
+            settings.brightness = 4;
+            storage.writeBudget = budget;
+            TEST_ASSERT_FALSE(journal.append(0, &settings, sizeof(settings)));
+        }
+        storage.writeBudget = SIZE_MAX;
+
+        Config::Journal journal(storage, MAGIC);
+        TEST_ASSERT_TRUE(journal.begin());
+        TEST_ASSERT_TRUE(journal.read(0, &settings, sizeof(settings)));
+        TEST_ASSERT_EQUAL_UINT8(3, settings.brightness);
+        uint32_t readIp;
+        TEST_ASSERT_TRUE(journal.read(1, &readIp, sizeof(readIp)));
+        TEST_ASSERT_EQUAL_HEX32(ip, readIp);
+    }
+}
+
+void test_foreign_data_is_not_used() {
+    RamStorage storage(256, 2);
+    {
+        Config::Journal journal(storage, MAGIC);
+        journal.begin();
+        Settings settings = {"kitchen", 10};
+        journal.append(0, &settings, sizeof(settings));
+    }
+
+    Config::Journal journal(storage, MAGIC + 1);
+    TEST_ASSERT_TRUE(journal.begin());
+    Settings settings;
+    TEST_ASSERT_FALSE(journal.read(0, &settings, sizeof(settings)));
+}
+
+// the storage can't be copied, so the config server edits a copy of the data
+static_assert(!std::is_copy_assignable<Config::PersistentConfig>::value, "PersistentConfig must not be copied");
+static_assert(std::is_copy_assignable<Config::PersistentConfig::Data>::value, "PersistentConfig::Data must be copyable");
+
+void test_edited_copy_leaves_data_unchanged() {
+    Config::PersistentConfig::Data data;
+    Config::SonosConfig(data.sonos).reset();
+    Config::LedConfig(data.led).reset();
+
+    // as in the POST handlers of Config::Server
+    Config::PersistentConfig::Data copy = data;
+    Config::SonosConfig sonosConfig(copy.sonos);
+    TEST_ASSERT_TRUE(sonosConfig.setActive(true));
+    TEST_ASSERT_TRUE(sonosConfig.setRoomUuid("RINCON_000E58000001400"));
+    Config::LedConfig ledConfig(copy.led);
+    TEST_ASSERT_TRUE(ledConfig.setBrightness(42));
+    TEST_ASSERT_TRUE(sonosConfig != Config::SonosConfig(data.sonos));
+    TEST_ASSERT_TRUE(ledConfig != Config::LedConfig(data.led));
+
+    data = copy;
+    TEST_ASSERT_TRUE(sonosConfig == Config::SonosConfig(data.sonos));
+    TEST_ASSERT_EQUAL_STRING("RINCON_000E58000001400", Config::SonosConfig(data.sonos).roomUuid());
+    TEST_ASSERT_EQUAL_UINT8(42, Config::LedConfig(data.led).brightness());
+}
+
+void test_crc32_check_value() {
+    TEST_ASSERT_EQUAL_HEX32(0xCBF43926, Util::CRC32::calculate("123456789", 9));
+    TEST_ASSERT_EQUAL_HEX32(0, Util::CRC32::calculate("", 0));
+}
+
+void test_crc32_matches_bitwise_crc32() {
+    uint8_t data[300];
+    for (size_t i = 0; i < sizeof(data); i++) {
+        data[i] = i * 7 + 3;
+    }
+    // every alignment and every length around the word boundaries
+    for (size_t offset = 0; offset < 4; offset++) {
+        for (size_t length = 0; length < sizeof(data) - offset; length += length < 16 ? 1 : 37) {
+            TEST_ASSERT_EQUAL_HEX32(bitwiseCrc32(data + offset, length), Util::CRC32::calculate(data + offset, length));
+        }
+    }
+}
+
+void test_crc32_updates_incrementally() {
+    uint8_t data[300];
+    for (size_t i = 0; i < sizeof(data); i++) {
+        data[i] = i * 13 + 1;
+    }
+    for (size_t split = 0; split <= sizeof(data); split += 7) {
+        Util::CRC32 crc;
+        crc.update(data, split).update(data + split, sizeof(data) - split);
+        TEST_ASSERT_EQUAL_HEX32(bitwiseCrc32(data, sizeof(data)), crc.value());
+    }
+
+    Util::CRC32 crc;
+    crc.update(data, sizeof(data));
+    crc.reset();
+    TEST_ASSERT_EQUAL_HEX32(0xCBF43926, crc.update("123456789", 9).value());
+}
+
+// the size of the configuration record, and of a flash sector
+void benchmark_crc32() {
+    static uint8_t data[4096];
+    for (size_t i = 0; i < sizeof(data); i++) {
+        data[i] = i * 7 + 3;
+    }
+    uint32_t crc = 0;
+    Benchmark::run("bitwise crc32 (176 bytes)", ITERATIONS, [&crc]() { crc ^= bitwiseCrc32(data, 176); });
+    Benchmark::run("Util::CRC32 (176 bytes)", ITERATIONS, [&crc]() { crc ^= Util::CRC32::calculate(data, 176); });
+    Benchmark::run("bitwise crc32 (4096 bytes)", ITERATIONS / 10, [&crc]() { crc ^= bitwiseCrc32(data, sizeof(data)); });
+    Benchmark::run("Util::CRC32 (4096 bytes)", ITERATIONS / 10, [&crc]() { crc ^= Util::CRC32::calculate(data, sizeof(data)); });
+    asm volatile("" : : "r"(crc) : "memory");
+}
+
+int main() {
+    UNITY_BEGIN();
+    RUN_TEST(test_empty_storage_is_formatted);
+    RUN_TEST(test_newest_record_is_recovered);
+    RUN_TEST(test_sectors_are_only_erased_when_full);
+    RUN_TEST(test_unchanged_record_is_not_written);
+    RUN_TEST(test_compaction_keeps_all_records);
+    RUN_TEST(test_interrupted_append_keeps_previous_version);
+    RUN_TEST(test_interrupted_compaction_keeps_all_records);
+    RUN_TEST(test_foreign_data_is_not_used);
+    RUN_TEST(test_edited_copy_leaves_data_unchanged);
+    RUN_TEST(test_crc32_check_value);
+    RUN_TEST(test_crc32_matches_bitwise_crc32);
+    RUN_TEST(test_crc32_updates_incrementally);
+    RUN_TEST(benchmark_crc32);
+    return UNITY_END();
+}
@@ -0,0 +1,56 @@
+#ifndef TEST_EVENT_PARSING_FIXTURES_H_
+#define TEST_EVENT_PARSING_FIXTURES_H_
+
+#include <string>
+
+// initial RenderingControl NOTIFY body, as sent right after subscribing (recorded from a Sonos One)
+const char RENDERING_CONTROL_INITIAL_EVENT[] =
+    "<e:propertyset xmlns:e=\"urn:schemas-upnp-org:event-1-0\"><e:property><LastChange>"
+    "&lt;Event xmlns=&quot;urn:schemas-upnp-org:metadata-1-0/RCS/&quot;&gt;&lt;InstanceID val=&quot;0&quot;&gt;"
+    "&lt;Volume channel=&quot;Master&quot; val=&quot;17&quot;/&gt;&lt;Volume channel=&quot;LF&quot; val=&quot;100&quot;/&gt;"
+    "&lt;Volume channel=&quot;RF&quot; val=&quot;100&quot;/&gt;&lt;Mute channel=&quot;Master&quot; val=&quot;0&quot;/&gt;"
+    "&lt;Mute channel=&quot;LF&quot; val=&quot;0&quot;/&gt;&lt;Mute channel=&quot;RF&quot; val=&quot;0&quot;/&gt;"
+    "&lt;Bass val=&quot;0&quot;/&gt;&lt;Treble val=&quot;0&quot;/&gt;&lt;Loudness channel=&quot;Master&quot; val=&quot;1&quot;/&gt;"
+    "&lt;OutputFixed val=&quot;0&quot;/&gt;&lt;HeadphoneConnected val=&quot;0&quot;/&gt;&lt;SpeakerSize val=&quot;3&quot;/&gt;"
+    "&lt;SubGain val=&quot;0&quot;/&gt;&lt;SubCrossover val=&quot;0&quot;/&gt;&lt;SubPolarity val=&quot;0&quot;/&gt;"
+    "&lt;SubEnabled val=&quot;1&quot;/&gt;&lt;SonarEnabled val=&quot;0&quot;/&gt;&lt;SonarCalibrationAvailable val=&quot;0&quot;/&gt;"
+    "&lt;PresetNameList val=&quot;FactoryDefaults&quot;/&gt;&lt;/InstanceID&gt;&lt;/Event&gt;"
+    "</LastChange></e:property></e:propertyset>";
+
+// RenderingControl NOTIFY body for a single step of the volume knob
+const char RENDERING_CONTROL_VOLUME_EVENT[] =
+    "<e:propertyset xmlns:e=\"urn:schemas-upnp-org:event-1-0\"><e:property><LastChange>"
+    "&lt;Event xmlns=&quot;urn:schemas-upnp-org:metadata-1-0/RCS/&quot;&gt;&lt;InstanceID val=&quot;0&quot;&gt;"
+    "&lt;Volume channel=&quot;Master&quot; val=&quot;18&quot;/&gt;&lt;/InstanceID&gt;&lt;/Event&gt;"
+    "</LastChange></e:property></e:propertyset>";
+
+// GetZoneGroupState response body of a household with the given number of single-player rooms
+// the member tags mimic those of current firmware, including all the attributes we don't care about
+inline std::string zoneGroupStateResponse(unsigned int players) {
+    std::string state;
+    for (unsigned int i = 0; i < players; i++) {
+        std::string uuid = "RINCON_48A6B8" + std::to_string(100000 + i) + "01400";
+        std::string ip = "192.168.1." + std::to_string(100 + i);
+        state += "&lt;ZoneGroup Coordinator=&quot;" + uuid + "&quot; ID=&quot;" + uuid + ":" + std::to_string(i) + "&quot;&gt;";
+        state += "&lt;ZoneGroupMember UUID=&quot;" + uuid + "&quot; Location=&quot;http://" + ip +
+                 ":1400/xml/device_description.xml&quot; ZoneName=&quot;Room " + std::to_string(i) +
+                 " &amp;amp; Co&quot; Icon=&quot;&quot; Configuration=&quot;1&quot; SoftwareVersion=&quot;79.1-52010&quot; SWGen=&quot;2&quot; "
+                 "MinCompatibleVersion=&quot;78.0-00000&quot; LegacyCompatibleVersion=&quot;58.0-00000&quot; BootSeq=&quot;118&quot; "
+                 "TVConfigurationError=&quot;0&quot; HdmiCecAvailable=&quot;0&quot; WirelessMode=&quot;1&quot; WirelessLeafOnly=&quot;0&quot; "
+                 "ChannelFreq=&quot;2437&quot; BehindWifiExtender=&quot;0&quot; WifiEnabled=&quot;1&quot; EthLink=&quot;0&quot; "
+                 "Orientation=&quot;0&quot; RoomCalibrationState=&quot;4&quot; SecureRegState=&quot;3&quot; VoiceConfigState=&quot;0&quot; "
+                 "MicEnabled=&quot;0&quot; AirPlayEnabled=&quot;1&quot; IdleState=&quot;1&quot; MoreInfo=&quot;&quot; SSLPort=&quot;1443&quot; "
+                 "HHSSLPort=&quot;1843&quot;/&gt;";
+        state += "&lt;/ZoneGroup&gt;";
+    }
+
+    return "<?xml version=\"1.0\"?><s:Envelope xmlns:s=\"http://schemas.xmlsoap.org/soap/envelope/\" "
+           "s:encodingStyle=\"http://schemas.xmlsoap.org/soap/encoding/\"><s:Body>"
+           "<u:GetZoneGroupStateResponse xmlns:u=\"urn:schemas-upnp-org:service:ZoneGroupTopology:1\"><ZoneGroupState>"
+           "&lt;ZoneGroupState&gt;&lt;ZoneGroups&gt;" +
+           state +
+           "&lt;/ZoneGroups&gt;&lt;VanishedDevices&gt;&lt;/VanishedDevices&gt;&lt;/ZoneGroupState&gt;"
+           "</ZoneGroupState></u:GetZoneGroupStateResponse></s:Body></s:Envelope>";
+}
+
+#endif /* TEST_EVENT_PARSING_FIXTURES_H_ */
@@ -0,0 +1,230 @@
+#include <unity.h>
+
+#include <Benchmark.h>
+#include <MemoryStream.h>
+
+#include <cstring>
+#include <string>
+
+#include "Sonos/RenderingControlEvent.h"
+#include "Sonos/ZoneGroupState.h"
+#include "XML/Utilities.h"
+
+#include "fixtures.h"
+
+const unsigned long ITERATIONS = 20000;
+
+void setUp() {
+}
+
+void tearDown() {
+}
+
+void test_initial_event_yields_complete_volume_state() {
+    MemoryStream stream(RENDERING_CONTROL_INITIAL_EVENT);
+    Sonos::VolumeState volumeState;
+
+    TEST_ASSERT_TRUE(Sonos::parseRenderingControlEvent(stream, volumeState));
+    TEST_ASSERT_TRUE(volumeState.isComplete());
+    TEST_ASSERT_EQUAL_INT(17, volumeState.master);
+    TEST_ASSERT_EQUAL_INT(100, volumeState.lf);
+    TEST_ASSERT_EQUAL_INT(100, volumeState.rf);
+    TEST_ASSERT_EQUAL_INT(0, volumeState.mute);
+}
+
+void test_volume_event_updates_master_only() {
+    MemoryStream stream(RENDERING_CONTROL_VOLUME_EVENT);
+    Sonos::VolumeState volumeState;
+    volumeState.lf = 100;
+
+    TEST_ASSERT_TRUE(Sonos::parseRenderingControlEvent(stream, volumeState));
+    TEST_ASSERT_EQUAL_INT(18, volumeState.master);
+    TEST_ASSERT_EQUAL_INT(100, volumeState.lf);
+    TEST_ASSERT_EQUAL_INT(-1, volumeState.rf);
+}
+
+void test_rendering_control_event_parses_in_slices() {
+    MemoryStream stream(RENDERING_CONTROL_INITIAL_EVENT);
+    Sonos::VolumeState volumeState;
+
+    Sonos::RenderingControlEventParser parser(volumeState);
+    XML::EncodedTagTokenizer::Result result;
+    while ((result = parser.parseAvailable(stream)) == XML::EncodedTagTokenizer::MORE) {
+        TEST_ASSERT_TRUE(stream.available() > 0);
+    }
+    TEST_ASSERT_EQUAL(XML::EncodedTagTokenizer::DONE, result);
+    TEST_ASSERT_TRUE(volumeState.isComplete());
+    TEST_ASSERT_EQUAL_INT(17, volumeState.master);
+    TEST_ASSERT_EQUAL_INT(0, volumeState.mute);
+}
+
+void test_zone_group_state_yields_all_players() {
+    std::string response = zoneGroupStateResponse(32);
+    MemoryStream stream(response.c_str(), response.length());
+
+    unsigned int players = 0;
+    Sonos::ZoneInfo last;
+    TEST_ASSERT_TRUE(Sonos::parseZoneGroupState(stream, [&players, &last](Sonos::ZoneInfo info) {
+        players++;
+        last = info;
+    }));
+    TEST_ASSERT_EQUAL_UINT(32, players);
+    TEST_ASSERT_EQUAL_STRING("RINCON_48A6B810003101400", last.uuid.c_str());
+    TEST_ASSERT_EQUAL_STRING("Room 31 & Co", last.name.c_str());
+    TEST_ASSERT_EQUAL_STRING("192.168.1.131", last.playerIP.toString().c_str());
+}
+
+void test_zone_group_state_parses_in_slices() {
+    std::string response = zoneGroupStateResponse(32);
+    MemoryStream stream(response.c_str(), response.length());
+
+    unsigned int players = 0;
+    Sonos::ZoneInfo last;
+    Sonos::ZoneGroupStateParser parser([&players, &last](const Sonos::ZoneInfo &info) {
+        players++;
+        last = info;
+    });
+    unsigned int slices = 1;
+    XML::EncodedTagTokenizer::Result result;
+    while ((result = parser.parseAvailable(stream)) == XML::EncodedTagTokenizer::MORE) {
+        TEST_ASSERT_TRUE(stream.available() > 0);
+        slices++;
+    }
+    TEST_ASSERT_EQUAL(XML::EncodedTagTokenizer::DONE, result);
+    TEST_ASSERT_EQUAL_UINT(32, players);
+    TEST_ASSERT_TRUE(slices > 1);
+    // a tag cut by a slice boundary is completed by the next slice
+    TEST_ASSERT_EQUAL_STRING("RINCON_48A6B810003101400", last.uuid.c_str());
+    TEST_ASSERT_EQUAL_STRING("Room 31 & Co", last.name.c_str());
+}
+
+void test_zone_group_state_lookup_stops_at_player() {
+    std::string response = zoneGroupStateResponse(32);
+    MemoryStream stream(response.c_str(), response.length());
+
+    IPAddress playerIP;
+    Sonos::ZoneGroupStateParser parser("RINCON_48A6B810000501400", &playerIP);
+    TEST_ASSERT_TRUE(parser.parse(stream));
+    TEST_ASSERT_TRUE(parser.found());
+    TEST_ASSERT_EQUAL_STRING("192.168.1.105", playerIP.toString().c_str());
+    // the rest of the response has not been read
+    TEST_ASSERT_TRUE(stream.available() > 0);
+}
+
+void test_zone_group_state_lookup_of_unknown_player() {
+    std::string response = zoneGroupStateResponse(32);
+    MemoryStream stream(response.c_str(), response.length());
+
+    IPAddress playerIP;
+    Sonos::ZoneGroupStateParser parser("RINCON_000000000000001400", &playerIP);
+    TEST_ASSERT_TRUE(parser.parse(stream));
+    TEST_ASSERT_FALSE(parser.found());
+}
+
+void test_tokenizer_filter_drops_unlisted_attributes() {
+    const char data[] = "&lt;a x=&quot;1&quot; y=&quot;2&quot; z=&quot;3&quot;/&gt;&lt;b y=&quot;4&quot;/&gt;</end>";
+    static const char *const tagNames[] = {"a", nullptr};
+    static const char *const attributeNames[] = {"y", nullptr};
+    char buffer[8];
+    XML::EncodedTagTokenizer tokenizer(buffer, sizeof(buffer), "</end>");
+    tokenizer.setFilter(tagNames, attributeNames);
+
+    unsigned int tags = 0;
+    TEST_ASSERT_EQUAL(XML::EncodedTagTokenizer::DONE, tokenizer.feed(data, strlen(data), [&tags](const XML::Tag &tag) {
+        tags++;
+        TEST_ASSERT_EQUAL_STRING("a", tag.name());
+        TEST_ASSERT_NULL(tag.attribute("x"));
+        TEST_ASSERT_EQUAL_STRING("2", tag.attribute("y"));
+        TEST_ASSERT_NULL(tag.attribute("z"));
+        return true;
+    }));
+    TEST_ASSERT_EQUAL_UINT(1, tags);
+}
+
+void benchmark_rendering_control_initial_event() {
+    MemoryStream stream(RENDERING_CONTROL_INITIAL_EVENT);
+    Benchmark::run("parseRenderingControlEvent (initial)", ITERATIONS, [&stream]() {
+        Sonos::VolumeState volumeState;
+        stream.rewind();
+        Sonos::parseRenderingControlEvent(stream, volumeState);
+    });
+}
+
+void benchmark_rendering_control_volume_event() {
+    MemoryStream stream(RENDERING_CONTROL_VOLUME_EVENT);
+    Benchmark::run("parseRenderingControlEvent (volume step)", ITERATIONS, [&stream]() {
+        Sonos::VolumeState volumeState;
+        stream.rewind();
+        Sonos::parseRenderingControlEvent(stream, volumeState);
+    });
+}
+
+void benchmark_extract_encoded_tags() {
+    MemoryStream stream(RENDERING_CONTROL_INITIAL_EVENT);
+    char tagBuffer[128];
+    Benchmark::run("XML::extractEncodedTags (initial event)", ITERATIONS, [&stream, &tagBuffer]() {
+        stream.rewind();
+        XML::extractEncodedTags(stream, "</LastChange>", tagBuffer, sizeof(tagBuffer), [](const XML::Tag &) { return true; });
+    });
+}
+
+void benchmark_extract_attribute_value() {
+    // a decoded tag, laid out like the tokenizer does it
+    const char tagData[] = "Volume\0channel\0Master\0val\0"
+                           "17";
+    XML::Tag tag(tagData, 2);
+    Benchmark::run("XML::extractAttributeValue", ITERATIONS * 10, [&tag]() {
+        const char *value;
+        XML::extractAttributeValue(tag, "val", &value);
+        asm volatile("" : : "r"(value) : "memory");
+    });
+}
+
+void benchmark_rendering_control_tag_callback() {
+    const char tagData[] = "Volume\0channel\0Master\0val\0"
+                           "17";
+    XML::Tag tag(tagData, 2);
+    Sonos::VolumeState volumeState;
+    Benchmark::run("renderingControlEventXmlTagCallback", ITERATIONS * 10,
+                   [&tag, &volumeState]() { Sonos::renderingControlEventXmlTagCallback(tag, volumeState); });
+}
+
+void benchmark_zone_group_state() {
+    std::string response = zoneGroupStateResponse(32);
+    MemoryStream stream(response.c_str(), response.length());
+    Benchmark::run("parseZoneGroupState (32 players)", ITERATIONS / 100, [&stream]() {
+        stream.rewind();
+        Sonos::parseZoneGroupState(stream, [](Sonos::ZoneInfo) {});
+    });
+}
+
+void benchmark_zone_group_state_lookup() {
+    std::string response = zoneGroupStateResponse(32);
+    MemoryStream stream(response.c_str(), response.length());
+    Benchmark::run("ZoneGroupStateParser lookup (player 16 of 32)", ITERATIONS / 100, [&stream]() {
+        IPAddress playerIP;
+        Sonos::ZoneGroupStateParser parser("RINCON_48A6B810001601400", &playerIP);
+        stream.rewind();
+        parser.parse(stream);
+    });
+}
+
+int main() {
+    UNITY_BEGIN();
+    RUN_TEST(test_initial_event_yields_complete_volume_state);
+    RUN_TEST(test_volume_event_updates_master_only);
+    RUN_TEST(test_rendering_control_event_parses_in_slices);
+    RUN_TEST(test_zone_group_state_yields_all_players);
+    RUN_TEST(test_zone_group_state_parses_in_slices);
+    RUN_TEST(test_zone_group_state_lookup_stops_at_player);
+    RUN_TEST(test_zone_group_state_lookup_of_unknown_player);
+    RUN_TEST(test_tokenizer_filter_drops_unlisted_attributes);
+    RUN_TEST(benchmark_rendering_control_initial_event);
+    RUN_TEST(benchmark_rendering_control_volume_event);
+    RUN_TEST(benchmark_extract_encoded_tags);
+    RUN_TEST(benchmark_extract_attribute_value);
+    RUN_TEST(benchmark_rendering_control_tag_callback);
+    RUN_TEST(benchmark_zone_group_state);
+    RUN_TEST(benchmark_zone_group_state_lookup);
+    return UNITY_END();
+}
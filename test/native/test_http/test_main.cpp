@@ -0,0 +1,203 @@
+#include <unity.h>
+
+#include <MemoryStream.h>
+
+#include <algorithm>
+#include <string>
+
+#include "HTTP/BodyStream.h"
+#include "HTTP/BufferedResponse.h"
+#include "HTTP/ConnectionPool.h"
+
+// records everything written to it, counting the writes
+class RecordingPrint : public Print {
+  public:
+    size_t write(uint8_t ch) override {
+        return write(&ch, 1);
+    }
+
+    size_t write(const uint8_t *buffer, size_t size) override {
+        data.append(reinterpret_cast<const char *>(buffer), size);
+        writes++;
+        return size;
+    }
+
+    std::string data;
+    unsigned int writes = 0;
+};
+
+const char HEAD[] = "HTTP/1.1 200 OK\r\nContent-Type: application/json\r\n";
+
+const IPAddress PLAYER(192, 168, 1, 20);
+
+void setUp() {
+    WiFiClient::connects = 0;
+}
+
+void tearDown() {
+}
+
+void test_small_body_is_sent_with_content_length() {
+    RecordingPrint out;
+    HTTP::BufferedResponse response(out, HEAD);
+    response.print("{\"a\":");
+    response.print(1);
+    response.print('}');
+    response.end();
+
+    TEST_ASSERT_FALSE(response.chunked());
+    TEST_ASSERT_EQUAL_STRING("HTTP/1.1 200 OK\r\nContent-Type: application/json\r\nContent-Length: 7\r\n\r\n{\"a\":1}", out.data.c_str());
+    // head and body in a single write, so Nagle has no small segment to hold back
+    TEST_ASSERT_EQUAL_UINT(1, out.writes);
+}
+
+void test_long_head_is_sent_on_its_own() {
+    std::string head = HEAD;
+    head += "X-Padding: " + std::string(600, 'x') + "\r\n";
+
+    RecordingPrint out;
+    HTTP::BufferedResponse response(out, head.c_str());
+    response.print("{}");
+    response.end();
+
+    std::string expected = head + "Content-Length: 2\r\n\r\n{}";
+    TEST_ASSERT_TRUE(out.data == expected);
+    TEST_ASSERT_EQUAL_UINT(2, out.writes);
+}
+
+void test_large_body_is_sent_in_chunks() {
+    std::string body;
+    for (int i = 0; i < 4000; i++) {
+        body += static_cast<char>('a' + i % 26);
+    }
+
+    RecordingPrint out;
+    HTTP::BufferedResponse response(out, HEAD);
+    // single characters and blocks, like a JSON serializer does it
+    for (size_t i = 0; i < body.length();) {
+        if (i % 3) {
+            response.write(static_cast<uint8_t>(body[i++]));
+        } else {
+            size_t length = std::min(static_cast<size_t>(97), body.length() - i);
+            response.write(reinterpret_cast<const uint8_t *>(body.data() + i), length);
+            i += length;
+        }
+    }
+    response.end();
+    TEST_ASSERT_TRUE(response.chunked());
+
+    std::string head = std::string(HEAD) + "Transfer-Encoding: chunked\r\n\r\n";
+    TEST_ASSERT_EQUAL_STRING(head.c_str(), out.data.substr(0, head.length()).c_str());
+
+    // decode the chunks
+    std::string decoded;
+    size_t position = head.length();
+    unsigned int chunks = 0;
+    while (true) {
+        size_t lineEnd = out.data.find("\r\n", position);
+        size_t length = std::stoul(out.data.substr(position, lineEnd - position), nullptr, 16);
+        position = lineEnd + 2;
+        if (!length) {
+            break;
+        }
+        decoded += out.data.substr(position, length);
+        TEST_ASSERT_EQUAL_STRING("\r\n", out.data.substr(position + length, 2).c_str());
+        position += length + 2;
+        chunks++;
+    }
+    TEST_ASSERT_EQUAL_STRING("\r\n", out.data.substr(position).c_str());
+    TEST_ASSERT_TRUE(decoded == body);
+
+    // one write per chunk, the head goes with the first one and the last chunk with the final one
+    TEST_ASSERT_EQUAL_UINT(3, chunks);
+    TEST_ASSERT_EQUAL_UINT(chunks, out.writes);
+}
+
+void test_body_stream_stops_at_content_length() {
+    MemoryStream stream("hello, next response");
+    HTTP::BodyStream body(stream, 5);
+
+    char buffer[16];
+    TEST_ASSERT_EQUAL_UINT(5, body.available());
+    TEST_ASSERT_EQUAL_UINT(5, body.readBytes(buffer, sizeof(buffer)));
+    TEST_ASSERT_EQUAL_UINT(0, body.available());
+    TEST_ASSERT_EQUAL_INT(-1, body.read());
+    TEST_ASSERT_TRUE(body.drain());
+    TEST_ASSERT_EQUAL_INT(',', stream.peek());
+}
+
+void test_body_stream_drains_the_rest() {
+    MemoryStream stream("hello, next response");
+    HTTP::BodyStream body(stream, 7);
+
+    TEST_ASSERT_EQUAL_INT('h', body.read());
+    TEST_ASSERT_TRUE(body.drain());
+    TEST_ASSERT_EQUAL_INT(0, body.remaining());
+    TEST_ASSERT_EQUAL_INT('n', stream.peek());
+}
+
+void test_body_stream_of_unknown_length_cannot_be_drained() {
+    MemoryStream stream("hello");
+    HTTP::BodyStream body(stream, -1);
+
+    TEST_ASSERT_EQUAL_UINT(5, body.available());
+    TEST_ASSERT_FALSE(body.drain());
+}
+
+void test_pool_reuses_keep_alive_connection() {
+    HTTP::ConnectionPool pool;
+    HTTPClient *http = pool.acquire(PLAYER, 1400, "/MediaRenderer/RenderingControl/Control");
+    TEST_ASSERT_NOT_NULL(http);
+    TEST_ASSERT_EQUAL(200, http->GET());
+    pool.release(http);
+
+    HTTPClient *again = pool.acquire("http://192.168.1.20:1400/MediaRenderer/RenderingControl/Event");
+    TEST_ASSERT_TRUE(again == http);
+    TEST_ASSERT_EQUAL_STRING("/MediaRenderer/RenderingControl/Event", again->uri().c_str());
+    TEST_ASSERT_EQUAL(200, again->GET());
+    pool.release(again);
+    TEST_ASSERT_EQUAL_UINT(1, WiFiClient::connects);
+}
+
+void test_pool_reconnects_closed_connection() {
+    HTTP::ConnectionPool pool;
+    HTTPClient *http = pool.acquire(PLAYER, 1400, "/status");
+    TEST_ASSERT_EQUAL(200, http->GET());
+    pool.release(http, false);
+
+    // the closed connection has dropped its client, so it must be set up again
+    for (int i = 0; i < 8; i++) {
+        http = pool.acquire(PLAYER, 1400, "/status");
+        TEST_ASSERT_NOT_NULL(http);
+        TEST_ASSERT_EQUAL(200, http->GET());
+        pool.release(http, false);
+    }
+    TEST_ASSERT_EQUAL_UINT(9, WiFiClient::connects);
+}
+
+void test_pool_reconnects_evicted_connection() {
+    HTTP::ConnectionPool pool(0);
+    HTTPClient *http = pool.acquire(PLAYER, 1400, "/status");
+    TEST_ASSERT_EQUAL(200, http->GET());
+    pool.release(http);
+
+    http = pool.acquire(PLAYER, 1400, "/status");
+    TEST_ASSERT_NOT_NULL(http);
+    TEST_ASSERT_EQUAL(200, http->GET());
+    pool.release(http);
+    TEST_ASSERT_EQUAL_UINT(2, WiFiClient::connects);
+}
+
+int main() {
+    UNITY_BEGIN();
+    RUN_TEST(test_small_body_is_sent_with_content_length);
+    RUN_TEST(test_long_head_is_sent_on_its_own);
+    RUN_TEST(test_large_body_is_sent_in_chunks);
+    RUN_TEST(test_body_stream_stops_at_content_length);
+    RUN_TEST(test_body_stream_drains_the_rest);
+    RUN_TEST(test_body_stream_of_unknown_length_cannot_be_drained);
+    RUN_TEST(test_pool_reuses_keep_alive_connection);
+    RUN_TEST(test_pool_reconnects_closed_connection);
+    RUN_TEST(test_pool_reconnects_evicted_connection);
+    return UNITY_END();
+}
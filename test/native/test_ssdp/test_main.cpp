@@ -0,0 +1,173 @@
+#include <unity.h>
+
+#include <string>
+
+#include "UPnP/PresenceCache.h"
+
+const char ZONE_PLAYER[] = "urn:schemas-upnp-org:device:ZonePlayer:1";
+
+const char ALIVE[] = "NOTIFY * HTTP/1.1\r\n"
+                     "HOST: 239.255.255.250:1900\r\n"
+                     "CACHE-CONTROL: max-age = 1800\r\n"
+                     "LOCATION: http://192.168.1.20:1400/xml/device_description.xml\r\n"
+                     "NT: urn:schemas-upnp-org:device:ZonePlayer:1\r\n"
+                     "NTS: ssdp:alive\r\n"
+                     "SERVER: Linux UPnP/1.0 Sonos/80.1-55240 (ZPS9)\r\n"
+                     "USN: uuid:RINCON_000E58000001400::urn:schemas-upnp-org:device:ZonePlayer:1\r\n"
+                     "X-RINCON-HOUSEHOLD: Sonos_abcdef\r\n"
+                     "\r\n";
+
+const char BYEBYE[] = "NOTIFY * HTTP/1.1\r\n"
+                      "HOST: 239.255.255.250:1900\r\n"
+                      "NT: urn:schemas-upnp-org:device:ZonePlayer:1\r\n"
+                      "NTS: ssdp:byebye\r\n"
+                      "USN: uuid:RINCON_000E58000001400::urn:schemas-upnp-org:device:ZonePlayer:1\r\n"
+                      "\r\n";
+
+const char RESPONSE[] = "HTTP/1.1 200 OK\r\n"
+                        "Cache-Control: max-age=60\r\n"
+                        "EXT:\r\n"
+                        "Location: http://192.168.1.21:1400/xml/device_description.xml\r\n"
+                        "Server: Linux UPnP/1.0 Sonos/80.1-55240 (ZPS9)\r\n"
+                        "ST: urn:schemas-upnp-org:device:ZonePlayer:1\r\n"
+                        "USN: uuid:RINCON_000E58000002400::urn:schemas-upnp-org:device:ZonePlayer:1\r\n"
+                        "\r\n";
+
+const IPAddress PLAYER1(192, 168, 1, 20);
+const IPAddress PLAYER2(192, 168, 1, 21);
+
+// the cache parses in place, so every message is handed over as a fresh copy
+static bool handle(UPnP::PresenceCache &cache, const std::string &message, const IPAddress &remoteIP, unsigned long nowMillis) {
+    std::string copy = message;
+    return cache.handle(&copy[0], remoteIP, nowMillis);
+}
+
+static std::string replace(std::string message, const std::string &from, const std::string &to) {
+    message.replace(message.find(from), from.length(), to);
+    return message;
+}
+
+void setUp() {
+}
+
+void tearDown() {
+}
+
+void test_alive_adds_device() {
+    UPnP::PresenceCache cache(ZONE_PLAYER);
+    IPAddress ip;
+    TEST_ASSERT_FALSE(cache.any(&ip, 0));
+
+    TEST_ASSERT_TRUE(handle(cache, ALIVE, PLAYER1, 1000));
+    TEST_ASSERT_TRUE(cache.any(&ip, 1000));
+    TEST_ASSERT_TRUE(ip == PLAYER1);
+    TEST_ASSERT_EQUAL(1, cache.entries().size());
+    TEST_ASSERT_EQUAL_STRING("uuid:RINCON_000E58000001400::urn:schemas-upnp-org:device:ZonePlayer:1", cache.entries()[0].usn.c_str());
+    TEST_ASSERT_EQUAL_STRING("http://192.168.1.20:1400/xml/device_description.xml", cache.entries()[0].location.c_str());
+    TEST_ASSERT_EQUAL(1800000, cache.entries()[0].maxAgeMillis);
+
+    // repeated announcements refresh the device instead of adding it again
+    TEST_ASSERT_TRUE(handle(cache, ALIVE, PLAYER1, 2000));
+    TEST_ASSERT_EQUAL(1, cache.entries().size());
+    TEST_ASSERT_EQUAL(2000, cache.entries()[0].seenMillis);
+}
+
+void test_byebye_removes_device() {
+    UPnP::PresenceCache cache(ZONE_PLAYER);
+    handle(cache, ALIVE, PLAYER1, 0);
+    TEST_ASSERT_TRUE(handle(cache, BYEBYE, PLAYER1, 10));
+    TEST_ASSERT_FALSE(cache.any(nullptr, 10));
+    TEST_ASSERT_FALSE(handle(cache, BYEBYE, PLAYER1, 20));
+}
+
+void test_search_response_adds_device() {
+    UPnP::PresenceCache cache(ZONE_PLAYER);
+    IPAddress ip;
+    TEST_ASSERT_TRUE(handle(cache, RESPONSE, PLAYER2, 0));
+    TEST_ASSERT_TRUE(cache.any(&ip, 0));
+    TEST_ASSERT_TRUE(ip == PLAYER2);
+    TEST_ASSERT_EQUAL(60000, cache.entries()[0].maxAgeMillis);
+}
+
+void test_other_messages_are_ignored() {
+    UPnP::PresenceCache cache(ZONE_PLAYER);
+    TEST_ASSERT_FALSE(handle(cache, replace(ALIVE, "device:ZonePlayer:1\r\nNTS", "service:AVTransport:1\r\nNTS"), PLAYER1, 0));
+    TEST_ASSERT_FALSE(handle(cache, replace(ALIVE, "NOTIFY * HTTP/1.1", "M-SEARCH * HTTP/1.1"), PLAYER1, 0));
+    TEST_ASSERT_FALSE(handle(cache, replace(ALIVE, "ssdp:alive", "ssdp:update"), PLAYER1, 0));
+    TEST_ASSERT_FALSE(handle(cache, replace(ALIVE, "USN:", "X-USN:"), PLAYER1, 0));
+    // a search response uses ST instead of NT
+    TEST_ASSERT_FALSE(handle(cache, replace(RESPONSE, "ST:", "NT:"), PLAYER2, 0));
+    // a truncated message without the headers of interest
+    TEST_ASSERT_FALSE(handle(cache, std::string(ALIVE, 60), PLAYER1, 0));
+    TEST_ASSERT_EQUAL(0, cache.entries().size());
+}
+
+void test_header_names_are_case_insensitive() {
+    UPnP::PresenceCache cache(ZONE_PLAYER);
+    std::string message = replace(replace(replace(ALIVE, "NT:", "nt:"), "USN:", "Usn:"), "LOCATION:", "location:");
+    TEST_ASSERT_TRUE(handle(cache, replace(message, "CACHE-CONTROL:", "cache-control:"), PLAYER1, 0));
+    TEST_ASSERT_EQUAL(1800000, cache.entries()[0].maxAgeMillis);
+}
+
+void test_max_age_expires_device() {
+    UPnP::PresenceCache cache(ZONE_PLAYER);
+    handle(cache, RESPONSE, PLAYER2, 1000);
+    TEST_ASSERT_TRUE(cache.any(nullptr, 60999));
+    TEST_ASSERT_FALSE(cache.any(nullptr, 61000));
+
+    // without max-age, the default is used, and excessive values are capped
+    handle(cache, replace(RESPONSE, "max-age=60", "no-cache"), PLAYER2, 0);
+    TEST_ASSERT_EQUAL(1800000, cache.entries()[0].maxAgeMillis);
+    handle(cache, replace(RESPONSE, "max-age=60", "max-age=4294967295"), PLAYER2, 0);
+    TEST_ASSERT_EQUAL(86400000, cache.entries()[0].maxAgeMillis);
+}
+
+void test_max_age_across_millis_overflow() {
+    UPnP::PresenceCache cache(ZONE_PLAYER);
+    handle(cache, RESPONSE, PLAYER2, static_cast<unsigned long>(-256));
+    TEST_ASSERT_TRUE(cache.any(nullptr, 59000));
+    TEST_ASSERT_FALSE(cache.any(nullptr, 60000));
+}
+
+void test_any_returns_most_recent_device() {
+    UPnP::PresenceCache cache(ZONE_PLAYER);
+    IPAddress ip;
+    handle(cache, ALIVE, PLAYER1, 0);
+    handle(cache, RESPONSE, PLAYER2, 100);
+    TEST_ASSERT_TRUE(cache.any(&ip, 200));
+    TEST_ASSERT_TRUE(ip == PLAYER2);
+    handle(cache, ALIVE, PLAYER1, 300);
+    TEST_ASSERT_TRUE(cache.any(&ip, 400));
+    TEST_ASSERT_TRUE(ip == PLAYER1);
+
+    cache.remove(PLAYER1);
+    TEST_ASSERT_TRUE(cache.any(&ip, 400));
+    TEST_ASSERT_TRUE(ip == PLAYER2);
+}
+
+void test_capacity_replaces_device_expiring_first() {
+    UPnP::PresenceCache cache(ZONE_PLAYER, 2);
+    handle(cache, ALIVE, PLAYER1, 0);
+    handle(cache, RESPONSE, PLAYER2, 0);
+    std::string third = replace(ALIVE, "RINCON_000E58000001400", "RINCON_000E58000003400");
+    TEST_ASSERT_TRUE(handle(cache, third, IPAddress(192, 168, 1, 22), 10));
+    TEST_ASSERT_EQUAL(2, cache.entries().size());
+    // the search response had the shorter max-age
+    for (const UPnP::PresenceCache::Entry &entry : cache.entries()) {
+        TEST_ASSERT_TRUE(entry.ip != PLAYER2);
+    }
+}
+
+int main() {
+    UNITY_BEGIN();
+    RUN_TEST(test_alive_adds_device);
+    RUN_TEST(test_byebye_removes_device);
+    RUN_TEST(test_search_response_adds_device);
+    RUN_TEST(test_other_messages_are_ignored);
+    RUN_TEST(test_header_names_are_case_insensitive);
+    RUN_TEST(test_max_age_expires_device);
+    RUN_TEST(test_max_age_across_millis_overflow);
+    RUN_TEST(test_any_returns_most_recent_device);
+    RUN_TEST(test_capacity_replaces_device_expiring_first);
+    return UNITY_END();
+}
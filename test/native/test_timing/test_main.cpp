@@ -0,0 +1,266 @@
+#include <unity.h>
+
+#include <Benchmark.h>
+
+#include <Arduino.h>
+#include <cstdlib>
+
+#include "Timing/Backoff.h"
+#include "Timing/Easing.h"
+#include "Timing/FrameScheduler.h"
+
+const unsigned long ITERATIONS = 1000000;
+
+void setUp() {
+}
+
+void tearDown() {
+}
+
+void test_easing_approaches_target() {
+    Timing::Easing easing(80);
+    easing.update(0);
+    easing.setTarget(65536, 0);
+
+    // about 63% of the distance after one time constant
+    int32_t value = easing.update(80);
+    TEST_ASSERT_INT_WITHIN(700, 41427, value);
+
+    // monotonic, no overshoot, and the target is reached exactly
+    unsigned long now = 80;
+    while (!easing.settled()) {
+        now += 10;
+        int32_t next = easing.update(now);
+        TEST_ASSERT_TRUE(next >= value);
+        TEST_ASSERT_TRUE(next <= 65536);
+        value = next;
+    }
+    TEST_ASSERT_EQUAL_INT(65536, easing.value());
+    TEST_ASSERT_TRUE(now < 80 * 16);
+}
+
+void test_easing_is_frame_rate_independent() {
+    Timing::Easing fast(80);
+    Timing::Easing slow(80);
+    fast.update(0);
+    slow.update(0);
+    fast.setTarget(-65536, 0);
+    slow.setTarget(-65536, 0);
+
+    for (unsigned long now = 0; now <= 200; now += 5) {
+        fast.update(now);
+    }
+    for (unsigned long now = 0; now <= 200; now += 40) {
+        slow.update(now);
+    }
+    // the truncation in every step only adds up to a few LSB
+    TEST_ASSERT_INT_WITHIN(64, fast.value(), slow.value());
+}
+
+void test_easing_follows_the_latest_target() {
+    Timing::Easing easing(80);
+    easing.update(0);
+
+    // a burst of targets, e.g. from a volume knob, within a single frame
+    for (int32_t target = 1000; target <= 30000; target += 1000) {
+        easing.setTarget(target, 0);
+    }
+    easing.update(40);
+    TEST_ASSERT_EQUAL_INT(30000, easing.target());
+    TEST_ASSERT_TRUE(easing.value() > 0 && easing.value() < 30000);
+
+    // direction changes continue from the current value
+    int32_t value = easing.value();
+    easing.setTarget(0, 40);
+    TEST_ASSERT_TRUE(easing.update(80) < value);
+}
+
+void test_easing_jumps_after_a_long_pause() {
+    Timing::Easing easing(80);
+    easing.update(1000);
+    easing.setTarget(12345, 1000);
+    TEST_ASSERT_EQUAL_INT(12345, easing.update(1000 + 12 * 80));
+
+    easing.set(7);
+    TEST_ASSERT_TRUE(easing.settled());
+    TEST_ASSERT_EQUAL_INT(7, easing.update(2000));
+}
+
+void test_easing_animates_after_a_long_idle_period() {
+    Timing::Easing easing(80);
+    easing.update(0);
+    easing.setTarget(65536, 0);
+    easing.update(12 * 80);
+    TEST_ASSERT_TRUE(easing.settled());
+
+    // e.g. the volume bar has been hidden for a while, the first change must not jump
+    easing.setTarget(0, 60000);
+    int32_t value = easing.update(60000 + 80);
+    TEST_ASSERT_INT_WITHIN(700, 65536 - 41427, value);
+}
+
+void test_easing_handles_millis_overflow() {
+    Timing::Easing easing(80);
+    easing.update(static_cast<unsigned long>(-20));
+    easing.setTarget(65536, static_cast<unsigned long>(-20));
+    int32_t value = easing.update(20);
+    TEST_ASSERT_INT_WITHIN(700, 26147, value);
+}
+
+void test_backoff_grows_with_jitter_up_to_maximum() {
+    Timing::Backoff backoff(1000, 60000);
+    backoff.seed(0x12345678);
+    TEST_ASSERT_TRUE(backoff.ready(0));
+
+    unsigned long now = 0;
+    unsigned long nominal = 1000;
+    for (int i = 0; i < 12; i++) {
+        backoff.failed(now);
+        unsigned long delay = backoff.delayMillis();
+        // between half and all of the nominal delay
+        TEST_ASSERT_TRUE(delay >= nominal / 2);
+        TEST_ASSERT_TRUE(delay <= nominal);
+        TEST_ASSERT_FALSE(backoff.ready(now + delay - 1));
+        TEST_ASSERT_TRUE(backoff.ready(now + delay));
+        now += delay;
+        nominal = nominal * 2 < 60000 ? nominal * 2 : 60000;
+    }
+    TEST_ASSERT_EQUAL(12, backoff.failures());
+
+    backoff.reset();
+    TEST_ASSERT_TRUE(backoff.ready(now));
+    TEST_ASSERT_EQUAL(0, backoff.failures());
+    backoff.failed(now);
+    TEST_ASSERT_TRUE(backoff.delayMillis() <= 1000);
+}
+
+void test_backoff_seeds_drift_apart() {
+    // devices failing at the same time don't retry at the same time
+    Timing::Backoff a(2000, 120000);
+    Timing::Backoff b(2000, 120000);
+    a.seed(0x00a1b2c3);
+    b.seed(0x00a1b2c4);
+    int same = 0;
+    for (int i = 0; i < 8; i++) {
+        a.failed(0);
+        b.failed(0);
+        same += a.delayMillis() == b.delayMillis();
+    }
+    TEST_ASSERT_TRUE(same < 2);
+}
+
+void test_backoff_handles_millis_overflow() {
+    Timing::Backoff backoff(1000, 60000);
+    backoff.failed(static_cast<unsigned long>(-100));
+    unsigned long delay = backoff.delayMillis();
+    TEST_ASSERT_FALSE(backoff.ready(delay - 101));
+    TEST_ASSERT_TRUE(backoff.ready(delay - 100));
+}
+
+void benchmark_easing_update() {
+    Timing::Easing easing(80);
+    unsigned long now = 0;
+    int32_t target = 0;
+    easing.update(now);
+    Benchmark::run("Timing::Easing::update (40 ms frame)", ITERATIONS, [&easing, &now, &target]() {
+        // retarget every few frames, like a volume knob
+        if (!(now % 160)) {
+            target ^= 65536;
+            easing.setTarget(target, now);
+        }
+        now += 40;
+        int32_t value = easing.update(now);
+        asm volatile("" : : "r"(value) : "memory");
+    });
+}
+
+void test_frame_scheduler_catches_up_to_max_frames() {
+    NativeClock::set(1000);
+    Timing::FrameScheduler scheduler(40000, Timing::FrameScheduler::CATCH_UP, 5);
+    TEST_ASSERT_EQUAL_UINT8(1, scheduler.poll());
+    TEST_ASSERT_EQUAL_UINT8(0, scheduler.poll());
+
+    // three frames missed, all of them are caught up
+    NativeClock::set(1000 + 4 * 40000 + 500);
+    TEST_ASSERT_EQUAL_UINT8(4, scheduler.poll());
+    TEST_ASSERT_EQUAL_UINT32(0, scheduler.framesSkipped());
+
+    // ten frames missed, only up to five are caught up
+    NativeClock::set(1000 + 15 * 40000);
+    TEST_ASSERT_EQUAL_UINT8(5, scheduler.poll());
+    TEST_ASSERT_EQUAL_UINT32(6, scheduler.framesSkipped());
+    TEST_ASSERT_EQUAL_UINT8(0, scheduler.poll());
+    TEST_ASSERT_EQUAL(400000, scheduler.maxJitterMicros());
+}
+
+void test_frame_scheduler_skips_missed_frames() {
+    NativeClock::set(0);
+    Timing::FrameScheduler scheduler(40000, Timing::FrameScheduler::SKIP);
+    TEST_ASSERT_EQUAL_UINT8(1, scheduler.poll());
+
+    NativeClock::set(3 * 40000 + 10);
+    TEST_ASSERT_EQUAL_UINT8(1, scheduler.poll());
+    TEST_ASSERT_EQUAL_UINT32(2, scheduler.framesSkipped());
+
+    // the schedule stays on multiples of the period
+    NativeClock::set(4 * 40000 - 1);
+    TEST_ASSERT_EQUAL_UINT8(0, scheduler.poll());
+    NativeClock::set(4 * 40000);
+    TEST_ASSERT_EQUAL_UINT8(1, scheduler.poll());
+    TEST_ASSERT_EQUAL_UINT32(2, scheduler.framesSkipped());
+}
+
+void test_frame_scheduler_averages_jitter_and_restarts() {
+    NativeClock::set(0);
+    Timing::FrameScheduler scheduler(40000, Timing::FrameScheduler::CATCH_UP, 5);
+    scheduler.poll();
+    for (unsigned long frame = 1; frame <= 200; frame++) {
+        NativeClock::set(frame * 40000 + 1000);
+        TEST_ASSERT_EQUAL_UINT8(1, scheduler.poll());
+    }
+    TEST_ASSERT_EQUAL(1000, scheduler.averageJitterMicros());
+    TEST_ASSERT_EQUAL(1000, scheduler.maxJitterMicros());
+
+    // e.g. a firmware upload blocked the main loop for seconds
+    NativeClock::set(201 * 40000 + 5000000);
+    scheduler.restart();
+    TEST_ASSERT_EQUAL_UINT8(1, scheduler.poll());
+    TEST_ASSERT_EQUAL(0, scheduler.maxJitterMicros());
+    TEST_ASSERT_EQUAL(0, scheduler.averageJitterMicros());
+    TEST_ASSERT_EQUAL_UINT32(0, scheduler.framesSkipped());
+}
+
+void test_frame_scheduler_handles_micros_overflow() {
+    NativeClock::set(static_cast<unsigned long>(-50000));
+    Timing::FrameScheduler scheduler(40000, Timing::FrameScheduler::CATCH_UP, 5);
+    TEST_ASSERT_EQUAL_UINT8(1, scheduler.poll());
+
+    // the next frame is due just before the overflow, the one after it just after
+    NativeClock::set(5);
+    TEST_ASSERT_EQUAL_UINT8(1, scheduler.poll());
+    NativeClock::set(30000 - 1);
+    TEST_ASSERT_EQUAL_UINT8(0, scheduler.poll());
+    NativeClock::set(30000 + 40000);
+    TEST_ASSERT_EQUAL_UINT8(2, scheduler.poll());
+    TEST_ASSERT_EQUAL_UINT32(0, scheduler.framesSkipped());
+    TEST_ASSERT_EQUAL(40000, scheduler.maxJitterMicros());
+}
+
+int main() {
+    UNITY_BEGIN();
+    RUN_TEST(test_easing_approaches_target);
+    RUN_TEST(test_easing_is_frame_rate_independent);
+    RUN_TEST(test_easing_follows_the_latest_target);
+    RUN_TEST(test_easing_jumps_after_a_long_pause);
+    RUN_TEST(test_easing_animates_after_a_long_idle_period);
+    RUN_TEST(test_easing_handles_millis_overflow);
+    RUN_TEST(test_backoff_grows_with_jitter_up_to_maximum);
+    RUN_TEST(test_backoff_seeds_drift_apart);
+    RUN_TEST(test_backoff_handles_millis_overflow);
+    RUN_TEST(test_frame_scheduler_catches_up_to_max_frames);
+    RUN_TEST(test_frame_scheduler_skips_missed_frames);
+    RUN_TEST(test_frame_scheduler_averages_jitter_and_restarts);
+    RUN_TEST(test_frame_scheduler_handles_micros_overflow);
+    RUN_TEST(benchmark_easing_update);
+    return UNITY_END();
+}
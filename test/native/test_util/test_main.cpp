@@ -0,0 +1,88 @@
+#include <unity.h>
+
+#include <atomic>
+#include <cstdint>
+#include <thread>
+
+#include "Util/Mailbox.h"
+
+struct State {
+    int8_t master, lf, rf, mute;
+};
+
+void setUp() {
+}
+
+void tearDown() {
+}
+
+void test_mailbox_is_empty_initially() {
+    Util::Mailbox<State> mailbox;
+    State state;
+    TEST_ASSERT_FALSE(mailbox.fetch(&state));
+}
+
+void test_mailbox_keeps_latest_value() {
+    Util::Mailbox<State> mailbox;
+    for (int8_t volume = 1; volume <= 10; volume++) {
+        mailbox.post({volume, 100, 100, 0});
+    }
+
+    State state;
+    TEST_ASSERT_TRUE(mailbox.fetch(&state));
+    TEST_ASSERT_EQUAL_INT(10, state.master);
+    TEST_ASSERT_EQUAL_UINT(9, mailbox.coalesced());
+
+    // every value is fetched once
+    TEST_ASSERT_FALSE(mailbox.fetch(&state));
+    mailbox.post({11, 100, 100, 0});
+    TEST_ASSERT_TRUE(mailbox.fetch(&state));
+    TEST_ASSERT_EQUAL_INT(11, state.master);
+    TEST_ASSERT_EQUAL_UINT(9, mailbox.coalesced());
+}
+
+// all fields of a posted value are equal, so a torn read would show up as a mix
+void test_mailbox_never_tears_values() {
+    struct Wide {
+        uint32_t words[16];
+    };
+    Util::Mailbox<Wide> mailbox;
+    std::atomic<bool> done{false};
+
+    std::thread producer([&mailbox, &done]() {
+        Wide value;
+        for (uint32_t i = 1; i <= 200000; i++) {
+            for (uint32_t &word : value.words) {
+                word = i;
+            }
+            mailbox.post(value);
+        }
+        done = true;
+    });
+
+    uint32_t last = 0;
+    bool torn = false;
+    bool backwards = false;
+    Wide value;
+    while (!done) {
+        if (mailbox.fetch(&value)) {
+            for (uint32_t word : value.words) {
+                torn |= word != value.words[0];
+            }
+            backwards |= value.words[0] <= last;
+            last = value.words[0];
+        }
+    }
+    producer.join();
+
+    TEST_ASSERT_FALSE(torn);
+    TEST_ASSERT_FALSE(backwards);
+}
+
+int main() {
+    UNITY_BEGIN();
+    RUN_TEST(test_mailbox_is_empty_initially);
+    RUN_TEST(test_mailbox_keeps_latest_value);
+    RUN_TEST(test_mailbox_never_tears_values);
+    return UNITY_END();
+}